@@ -0,0 +1,469 @@
+#include "Benchmark.hpp"
+#include "audio_externs.h"
+#include "Control.hpp"
+#include "Preset.hpp"
+#include <functional>
+#include <optional>
+#include "../ext/Audio/Resampler.h"
+#include "../ext/Audio/resample-quality.h"
+
+namespace audio {
+
+#ifdef TIE_BENCHMARK
+
+namespace {
+
+constexpr auto tableSize = AudioSynthAdditive::partial_table_size;
+
+DMAMEM float benchPartials[tableSize];
+DMAMEM float benchScratch[tableSize];
+DMAMEM float benchSignal[tableSize];
+
+/// @brief Fill the bench partial table with `count` random bins.
+void random_partials(int count) {
+    std::fill(benchPartials, benchPartials + tableSize, 0.f);
+    for (int i = 0; i < count; i++) {
+        int bin = random(1, tableSize / 2);
+        benchPartials[bin * 2] = random(1, 100);
+        benchPartials[bin * 2 + 1] = random(1, 100);
+    }
+}
+
+/// @brief Compare the IFFT and oscillator kernels of `AudioSynthAdditive`, and suggest a crossover.
+void bench_additive_kernels() {
+    arm_rfft_fast_instance_f32 fft;
+    arm_rfft_fast_init_4096_f32(&fft);
+
+    random_partials(tableSize / 2);
+    uint32_t fftCycles = time_cycles([&]() {
+        std::copy(benchPartials, benchPartials + tableSize, benchScratch);
+        arm_rfft_fast_f32(&fft, benchScratch, benchSignal, 1);
+    });
+    Serial.printf("additive: ifft %d cycles\n", fftCycles);
+
+    std::array<additive::SparsePartial, 64> sparse;
+    int crossover = 0;
+    for (int n = 1; n <= (int) sparse.size(); n *= 2) {
+        random_partials(n);
+        int found = additive::find_sparse_partials(benchPartials, tableSize, sparse.data(), sparse.size());
+        uint32_t sparseCycles = time_cycles([&]() {
+            additive::find_sparse_partials(benchPartials, tableSize, sparse.data(), sparse.size());
+            additive::render_sparse(sparse.data(), found, benchSignal, tableSize);
+        });
+        Serial.printf("additive: %d oscillators %d cycles\n", found, sparseCycles);
+
+        if (sparseCycles < fftCycles) crossover = found;
+    }
+    Serial.printf("additive: suggested ADDITIVE_SPARSE_CROSSOVER=%d\n", crossover);
+}
+
+/// @brief Compare the block oscillator bank kernel and control-rate envelope with the original
+/// per-sample kernel and per-sample envelope, for speed and accuracy.
+/// @tparam harmonics bank size, to see how the cost scales
+template <int harmonics>
+void bench_oscbank_kernel() {
+    constexpr int n = AUDIO_BLOCK_SAMPLES;
+
+    uint32_t phases[harmonics], increments[harmonics];
+    float start[harmonics * 2], step[harmonics * 2];
+    static float amplitudes[harmonics * n];
+    static uint32_t offsets[harmonics * n];
+
+    for (int h = 0; h < harmonics; h++) {
+        phases[h] = random(0, INT32_MAX) * 2u;
+        increments[h] = (h + 1) * 440.f * (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT);
+        start[h] = 0.5f / (h + 1);
+        step[h] = -start[h] / 1000;
+        start[h + harmonics] = random(0, INT32_MAX);
+        step[h + harmonics] = random(0, 100000);
+
+        // the same ramp, a sample at a time, for the reference kernel.
+        for (int i = 0; i < n; i++) {
+            amplitudes[h * n + i] = start[h] + step[h] * i;
+            offsets[h * n + i] = start[h + harmonics] + step[h + harmonics] * i;
+        }
+    }
+
+    const oscbank::Ramp ramp {start, step, start + harmonics, step + harmonics};
+
+    float blockOut[n] {}, referenceOut[n] {};
+    uint32_t blockCycles = time_cycles([&]() {
+        oscbank::render_block<oscbank::Taylor>(phases, increments, ramp, harmonics, 0, n, blockOut);
+    });
+    uint32_t referenceCycles = time_cycles([&]() {
+        oscbank::render_reference(phases, increments, amplitudes, offsets, harmonics, referenceOut);
+    });
+
+    // both ran the same number of times, so the accumulated outputs should match.
+    float maxError = 0;
+    for (int i = 0; i < n; i++) {
+        maxError = std::max(maxError, fabsf(blockOut[i] - referenceOut[i]));
+    }
+
+    // the block renderer was meant to come in at about a third of the reference's cycles.
+    const float speedup = (float) referenceCycles / blockCycles;
+    Serial.printf("oscbank: %d harmonics, reference %d cycles (%.1f/sample), block %d cycles (%.1f/sample, %d per harmonic), %.2fx%s, max difference %g\n",
+        harmonics, referenceCycles, (float) referenceCycles / n, blockCycles, (float) blockCycles / n, blockCycles / harmonics,
+        speedup, speedup >= 3 ? "" : " (under the 3x target)", maxError);
+
+    typename AudioSynthOscBankN<harmonics>::Envelope perSample, perBlock;
+    uint32_t sampleCycles = time_cycles([&]() {
+        for (int i = 0; i < n; i++) perSample.next();
+    });
+    uint32_t spanCycles = time_cycles([&]() {
+        for (int i = 0; i < n; ) i += perBlock.span(n - i, start, step);
+    });
+
+    Serial.printf("oscbank: envelope per sample %d cycles/block, per span %d cycles/block\n", sampleCycles, spanCycles);
+}
+
+/// @brief Time one sine kernel across a bank's worth of harmonics, and measure its distortion.
+template <typename Sine>
+void bench_sine_kernel(const char *name) {
+    constexpr int harmonics = AudioSynthOscBank::bankSize;
+    constexpr int n = AUDIO_BLOCK_SAMPLES;
+
+    uint32_t phases[harmonics], increments[harmonics];
+    float start[harmonics * 2] {}, step[harmonics * 2] {};
+    for (int h = 0; h < harmonics; h++) {
+        phases[h] = random(0, INT32_MAX) * 2u;
+        increments[h] = (h + 1) * 440.f * (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT);
+        start[h] = 0.5f / (h + 1);
+    }
+    const oscbank::Ramp ramp {start, step, start + harmonics, step + harmonics};
+
+    float out[n] {};
+    uint32_t cycles = time_cycles([&]() {
+        oscbank::render_block<Sine>(phases, increments, ramp, harmonics, 0, n, out);
+    });
+
+    // a low partial and a bright one, both on exact bins of the 4096-point measurement.
+    auto low = oscbank::sine_quality<Sine>(37);
+    auto high = oscbank::sine_quality<Sine>(371);
+
+    Serial.printf("sine %s: %.2f cycles/sample, SNR %.1f/%.1f dB, THD %.1f/%.1f dB (400 Hz/4 kHz)\n",
+        name, (float) cycles / (harmonics * n), low.snrDb, high.snrDb, low.thdDb, high.thdDb);
+}
+
+/// @brief Compare the Resampler's double precision position tracking with its 32.32 fixed point path.
+void bench_resampler() {
+    constexpr int n = 128;
+    constexpr int blocks = 20;
+    static float in0[n], in1[n], out0[n * 2], out1[n * 2], fixed0[n * 2], fixed1[n * 2];
+
+    // on the stack, so their filter table goes back when the bench is done, rather than keeping
+    // one of the few `MAX_FILTER_TABLES` slots from `bench_resampling()`.
+    Resampler reference, fixed;
+
+    // the S/PDIF input's usual job, including a nudge from the step adaption.
+    reference.configure(48000, AUDIO_SAMPLE_RATE_EXACT);
+    fixed.configure(48000, AUDIO_SAMPLE_RATE_EXACT);
+    fixed.fixedPointPosition(true);
+    reference.addToSampleDiff(0.3);
+    fixed.addToSampleDiff(0.3);
+
+    uint32_t referenceCycles = 0, fixedCycles = 0;
+    int outputs = 0;
+    float maxError = 0;
+    for (int b = 0; b < blocks; b++) {
+        for (int i = 0; i < n; i++) {
+            in0[i] = 0.5f * sinf((b * n + i) * 0.131f) + 0.3f * sinf((b * n + i) * 1.96f);
+            in1[i] = in0[i];
+        }
+
+        uint16_t processed, count, fixedCount;
+        uint32_t start = ARM_DWT_CYCCNT;
+        reference.resample(in0, in1, n, processed, out0, out1, n * 2, count);
+        referenceCycles += ARM_DWT_CYCCNT - start;
+
+        start = ARM_DWT_CYCCNT;
+        fixed.resample(in0, in1, n, processed, fixed0, fixed1, n * 2, fixedCount);
+        fixedCycles += ARM_DWT_CYCCNT - start;
+
+        outputs += count;
+        for (int i = 0; i < std::min(count, fixedCount); i++) {
+            maxError = std::max(maxError, fabsf(out0[i] - fixed0[i]));
+        }
+    }
+
+    Serial.printf("resampler: half length %d, double %d cycles/sample, fixed point %d cycles/sample, max difference %g\n",
+        reference.getHalfFilterLength(), referenceCycles / outputs, fixedCycles / outputs, maxError);
+}
+
+/// @brief Pitch ratios the resampling methods are compared at, from an octave down to an octave and a half up.
+constexpr double resampleRatios[] = {0.5, 0.75, 0.99, 1.0, 1.01, 1.5, 2.0, 3.0};
+
+/// @brief Time a resampling method and measure its quality at every ratio, and print one JSON
+/// line per ratio (see `resample-quality.h`).
+/// @param method name for the report
+/// @param render the method, rendering from a float table
+/// @param timed renders `resample::quality_outputs` samples at a ratio, as the method would in use
+/// @param prepare gets the method ready for a ratio, returning false if it can't run at it. Those
+/// ratios get a skipped line.
+template <typename Render, typename Timed, typename Prepare>
+void report_resampling(const char *method, Render &&render, Timed &&timed, Prepare &&prepare) {
+    for (double ratio : resampleRatios) {
+        char line[192];
+        if (!prepare(ratio)) {
+            resample::format_resample_skipped(line, sizeof(line), method, ratio, "no filter table");
+            Serial.println(line);
+            continue;
+        }
+
+        const uint32_t cycles = time_cycles([&]() { timed(ratio); }, 2);
+        const auto quality = resample::resample_quality(render, ratio, benchScratch, benchSignal);
+
+        resample::format_resample_report(line, sizeof(line), method, ratio, (double) cycles / resample::quality_outputs, quality);
+        Serial.println(line);
+    }
+}
+
+template <typename Render, typename Timed>
+void report_resampling(const char *method, Render &&render, Timed &&timed) {
+    report_resampling(method, render, timed, [](double) { return true; });
+}
+
+/// @brief Time a method by rendering a measurement's worth of output, from whatever table it last played.
+template <typename Render>
+auto timed_render(Render &render) {
+    return [&render](double ratio) {
+        render(benchScratch, resample::quality_table_bits, ratio, benchSignal, resample::quality_outputs);
+    };
+}
+
+template <typename Render>
+void report_resampling(const char *method, Render &&render) {
+    report_resampling(method, render, timed_render(render));
+}
+
+/// @brief The S/PDIF `Resampler` `render_streamed()` plays through, held for one ratio at a time.
+std::optional<Resampler> streamer;
+
+/// @brief Set the streamer up for a ratio.
+/// @return false if it couldn't get a filter table
+bool prepare_streamer(double ratio) {
+    // a fresh one rather than reconfiguring: that takes the new table before letting go of the old
+    // one, so it needs a slot more than a single ratio does.
+    streamer.reset();
+    streamer.emplace();
+    return streamer->configure(ratio * AUDIO_SAMPLE_RATE_EXACT, AUDIO_SAMPLE_RATE_EXACT);
+}
+
+/// @brief Stream a looped table through the streamer, a block at a time, from the start. Outputs
+/// silence if `prepare_streamer()` didn't get it a table for this ratio.
+void render_streamed(bool fixed, const float *table, int sizeBits, double ratio, float *out, int count) {
+    constexpr int n = 128;
+    static float block[n];
+
+    // the same rates again, so this keeps the table and only resets the position and history.
+    if (!streamer || !streamer->configure(ratio * AUDIO_SAMPLE_RATE_EXACT, AUDIO_SAMPLE_RATE_EXACT)) {
+        std::fill(out, out + count, 0.f);
+        return;
+    }
+    const int mask = (1 << sizeBits) - 1;
+
+    int read = 0, written = 0;
+    while (written < count) {
+        for (int i = 0; i < n; i++) block[i] = table[(read + i) & mask];
+
+        float *inputs[1] = {block};
+        float *outputs[1] = {out + written};
+        uint16_t processed, produced;
+        if (fixed) streamer->resampleFixed<1>(inputs, n, processed, outputs, count - written, produced);
+        else streamer->resample<1>(inputs, n, processed, outputs, count - written, produced);
+
+        read += processed;
+        written += produced;
+    }
+}
+
+/// @brief Compare every way the tree reads between samples: the per-sample windowed sinc in
+/// `synth_additive.cpp`, the additive's polyphase bank, the S/PDIF `Resampler` (both position
+/// paths), and `AudioSynthWavetable`'s linear interpolation.
+void bench_resampling() {
+    Serial.println("resampling: begin report");
+
+    report_resampling("windowed_sinc", [](const float *table, int sizeBits, double ratio, float *out, int count) {
+        resample::windowed_sinc_interpolation({const_cast<float *>(table), 1 << sizeBits}, {out, count},
+            ratio * AUDIO_SAMPLE_RATE_EXACT, AUDIO_SAMPLE_RATE_EXACT, resample::sample_loop, 0, false);
+    });
+
+    static AudioSynthAdditive::Resampler polyphase;
+    report_resampling("polyphase", [](const float *table, int sizeBits, double ratio, float *out, int count) {
+        const uint32_t increment = ratio * (1u << (32 - sizeBits));
+        uint32_t phase = 0;
+        for (int i = 0; i < count; i++, phase += increment) {
+            out[i] = polyphase.read_cycle(table, sizeBits, phase);
+        }
+    });
+
+    auto resampler = [](const float *table, int sizeBits, double ratio, float *out, int count) {
+        render_streamed(false, table, sizeBits, ratio, out, count);
+    };
+    auto resamplerFixed = [](const float *table, int sizeBits, double ratio, float *out, int count) {
+        render_streamed(true, table, sizeBits, ratio, out, count);
+    };
+    report_resampling("resampler", resampler, timed_render(resampler), prepare_streamer);
+    report_resampling("resampler_fixed", resamplerFixed, timed_render(resamplerFixed), prepare_streamer);
+    streamer.reset();
+
+    // the wavetable plays samples that are already 16-bit, so only its interpolation is timed.
+    static int16_t samples[1 << resample::quality_table_bits];
+    report_resampling("wavetable_linear",
+        [](const float *table, int sizeBits, double ratio, float *out, int count) {
+            resample::WavetableLinear::quantize(table, samples, 1 << sizeBits);
+            resample::WavetableLinear::render(samples, sizeBits, ratio, out, count);
+        },
+        [](double ratio) {
+            resample::WavetableLinear::render(samples, resample::quality_table_bits, ratio, benchSignal, resample::quality_outputs);
+        });
+
+    Serial.println("resampling: end report");
+}
+
+/// @brief Compare `Control`'s in-place callback and plain limits with the `std::function` and
+/// `std::optional` members it used to have, for size and for the cost of a call.
+void bench_control_callbacks() {
+    constexpr int calls = 1000;
+
+    struct Legacy {
+        std::optional<std::function<void(float const&)>> onUpdate;
+        std::optional<std::tuple<float, float>> limits;
+    };
+    struct Lean {
+        bool limited;
+        ControlCallback<float> onUpdate;
+        float lower, upper;
+    };
+
+    // the usual shape of an update function: a lambda capturing the object it sets.
+    static struct Target {
+        float gain;
+    } target;
+
+    static Legacy legacy {[t = &target](float const& g) { t->gain = g; }, std::make_tuple(0.f, 1.f)};
+    static Lean lean {true, [t = &target](float const& g) { t->gain = g; }, 0.f, 1.f};
+
+    // through volatile pointers, so neither call can be inlined away.
+    Legacy *volatile legacyPtr = &legacy;
+    Lean *volatile leanPtr = &lean;
+
+    uint32_t legacyCycles = time_cycles([&]() {
+        for (int i = 0; i < calls; i++) legacyPtr->onUpdate.value()(i * 0.001f);
+    });
+    uint32_t leanCycles = time_cycles([&]() {
+        for (int i = 0; i < calls; i++) leanPtr->onUpdate(i * 0.001f);
+    });
+
+    Serial.printf("control: sizeof(Control<float>) %d, callback and limits %d bytes (std::function and std::optional %d), call %.1f cycles (std::function %.1f)\n",
+        (int) sizeof(Control<float>), (int) sizeof(Lean), (int) sizeof(Legacy), (float) leanCycles / calls, (float) legacyCycles / calls);
+}
+
+/// @brief Time saving and loading the whole preset, through memory so the SD card doesn't count.
+void bench_presets() {
+    constexpr size_t capacity = 256 * 1024;
+    auto *data = (uint8_t *) extmem_malloc(capacity);
+    if (!data) {
+        Serial.println("preset: no room for the bench");
+        return;
+    }
+
+    size_t size = 0;
+    uint32_t saveCycles = time_cycles([&]() {
+        MemoryPreset preset(data, capacity);
+        write_preset(preset);
+        size = preset.size();
+    }, 2);
+
+    bool ok = true;
+    uint32_t loadCycles = time_cycles([&]() {
+        MemoryPreset preset(data, capacity, size);
+        ok &= read_preset(preset);
+    }, 2);
+
+    Serial.printf("preset: %d bytes, save %d cycles (%d us), load %d cycles (%d us)%s\n",
+        (int) size, saveCycles, (int) (saveCycles / (F_CPU_ACTUAL / 1000000)),
+        loadCycles, (int) (loadCycles / (F_CPU_ACTUAL / 1000000)), ok ? "" : ", damaged on reading");
+
+    extmem_free(data);
+}
+
+/// @brief An event that reschedules itself every `period` ticks.
+struct BenchEvent : public TimerEventInterface {
+    TimerWheel *wheel = nullptr;
+    Tick period = 0;
+
+    virtual void execute() override { wheel->schedule(this, period); }
+};
+
+/// @brief Compare stepping a `TimerWheel` one sample at a time against once per block.
+void bench_timer_wheel() {
+    constexpr int blocks = 100;
+    constexpr int nEvents = 10;
+
+    // Grain-like spacing: mostly far in the future, with the odd event due every few blocks.
+    for (Tick shortest : {Tick(AUDIO_BLOCK_SAMPLES * 500), Tick(AUDIO_BLOCK_SAMPLES * 3 + 7)}) {
+        TimerWheel perSample, perBlock;
+        BenchEvent sampleEvents[nEvents], blockEvents[nEvents];
+
+        for (int i = 0; i < nEvents; i++) {
+            Tick period = shortest + i * 1009;
+            sampleEvents[i].wheel = &perSample;
+            sampleEvents[i].period = period;
+            perSample.schedule(&sampleEvents[i], period);
+
+            blockEvents[i].wheel = &perBlock;
+            blockEvents[i].period = period;
+            perBlock.schedule(&blockEvents[i], period);
+        }
+
+        uint32_t sampleCycles = time_cycles([&]() {
+            for (int b = 0; b < blocks; b++) {
+                for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+                    perSample.advance(1);
+                }
+            }
+        });
+
+        uint32_t blockCycles = time_cycles([&]() {
+            for (int b = 0; b < blocks; b++) {
+                perBlock.advance_block(AUDIO_BLOCK_SAMPLES);
+            }
+        });
+
+        Serial.printf("timer wheel: shortest period %d, per sample %d cycles/block, per block %d cycles/block\n",
+            (int) shortest, sampleCycles / blocks, blockCycles / blocks);
+    }
+}
+
+}
+
+void run_benchmarks() {
+    Serial.println("Running benchmarks.");
+
+    AudioNoInterrupts();
+    bench_additive_kernels();
+    bench_timer_wheel();
+    bench_control_callbacks();
+    bench_presets();
+    bench_resampler();
+    bench_resampling();
+    bench_oscbank_kernel<16>();
+    bench_oscbank_kernel<32>();
+    bench_oscbank_kernel<64>();
+    bench_sine_kernel<oscbank::Taylor>("taylor");
+    bench_sine_kernel<oscbank::Minimax>("minimax");
+    bench_sine_kernel<oscbank::Table>("table");
+    bench_sine_kernel<oscbank::Rotator>("rotator");
+    AudioInterrupts();
+
+    Serial.println("Finished benchmarks.");
+}
+
+#else
+
+void run_benchmarks() {}
+
+#endif
+
+}
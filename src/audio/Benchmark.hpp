@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace audio {
+
+/// @brief Time `f` in CPU cycles, taking the best of `reps` runs.
+template <typename F>
+uint32_t time_cycles(F &&f, int reps = 8) {
+    uint32_t best = UINT32_MAX;
+    for (int i = 0; i < reps; i++) {
+        uint32_t start = ARM_DWT_CYCCNT;
+        f();
+        uint32_t elapsed = ARM_DWT_CYCCNT - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+/// @brief Run the DSP kernel benchmarks and print the results to Serial. Only does anything when built
+/// with `TIE_BENCHMARK` defined (see the `teensy41_bench` environment).
+void run_benchmarks();
+
+}
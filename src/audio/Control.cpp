@@ -1,10 +1,38 @@
 #include "Control.hpp"
 
+#include <array>
+#include <atomic>
+
+/// @brief Most controls that can be waiting to be applied at once. A control is only ever queued
+/// once, so this is plenty if it's at least the number of controls; past that, the next block
+/// falls back to checking every control.
+#ifndef CONTROL_QUEUE_SIZE
+#define CONTROL_QUEUE_SIZE 128
+#endif
+
 namespace audio {
 
 _ControlBase* firstControl = nullptr;
 _ControlBase* lastRegisteredControl = nullptr;
 
+namespace {
+
+static_assert((CONTROL_QUEUE_SIZE & (CONTROL_QUEUE_SIZE - 1)) == 0, "CONTROL_QUEUE_SIZE must be a power of two.");
+
+/// @brief Changed controls, from `loop()` to the audio interrupt. Single producer, single consumer:
+/// only `loop()` moves the head and only the audio interrupt moves the tail.
+std::array<_ControlBase*, CONTROL_QUEUE_SIZE> changeQueue;
+volatile uint32_t changeHead = 0;
+volatile uint32_t changeTail = 0;
+
+/// @brief Set when a control couldn't be queued, so the next block checks them all.
+volatile bool changeOverflow = false;
+
+/// @brief Number of live `ControlBatch`es. The audio interrupt leaves the queue alone while it's nonzero.
+volatile int batchDepth = 0;
+
+}
+
 
 
 _ControlBase* get_first_control() {
@@ -15,11 +43,68 @@ _ControlBase* get_first_control() {
 void run_all_control_updates() {
     auto control = audio::get_first_control();
     do {
-        control->doUpdate();
+        control->enqueue();
     } while ( (control = control->nextControl()) );
 }
 
 
+void apply_queued_controls() {
+    if (batchDepth) return;
+
+    if (changeOverflow) {
+        changeOverflow = false;
+
+        // doUpdate() does nothing for a clean control, so anything left in the queue is harmless.
+        auto control = get_first_control();
+        do {
+            control->doUpdate();
+        } while ( (control = control->nextControl()) );
+    }
+
+    const uint32_t head = changeHead;
+    for (uint32_t tail = changeTail; tail != head; ) {
+        auto control = changeQueue[tail % CONTROL_QUEUE_SIZE];
+        changeTail = ++tail;
+
+        // clear this first, so a set() that lands after we've read the value queues it again.
+        control->queued = false;
+        control->doUpdate();
+    }
+}
+
+
+ControlBatch::ControlBatch() {
+    batchDepth = batchDepth + 1;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+
+ControlBatch::~ControlBatch() {
+    // the batch's entries have to be in the queue before the audio interrupt can go looking.
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    batchDepth = batchDepth - 1;
+}
+
+
+void _ControlBase::enqueue() {
+    if (queued) return;
+
+    const uint32_t head = changeHead;
+    if (head - changeTail >= CONTROL_QUEUE_SIZE) {
+        changeOverflow = true;
+        return;
+    }
+
+    queued = true;
+    changeQueue[head % CONTROL_QUEUE_SIZE] = this;
+
+    // the entry has to be written before the audio interrupt can see it. Same core, so the
+    // compiler is the only thing that could reorder it.
+    std::atomic_signal_fence(std::memory_order_release);
+    changeHead = head + 1;
+}
+
+
 void _ControlBase::register_new_control(_ControlBase* control) {
     if (!firstControl) {
         firstControl = lastRegisteredControl = control;
@@ -30,4 +115,4 @@ void _ControlBase::register_new_control(_ControlBase* control) {
     lastRegisteredControl = control;
 }
 
-}
\ No newline at end of file
+}
@@ -1,50 +1,160 @@
 #pragma once
 
-#include <functional>
-#include <optional>
+#include <AudioStream.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <new>
 #include <tuple>
+#include <type_traits>
 #include <util/emmath.h>
+#include "../ext/Audio/dezipper.hpp"
 
 namespace audio {
 
+/// @brief A control's value as it goes into a preset: four bytes and what they hold.
+struct ControlValue {
+    enum Type : uint8_t {
+        Float = 'f',
+        Signed = 's',
+        Unsigned = 'u',
+    };
+
+    uint8_t type;
+    uint32_t bits;
+};
+
 class _ControlBase {
 protected:
     /// Register a new control.
     static void register_new_control(_ControlBase* control);
 
+    /// @brief Queue this control to be applied at the start of the next audio block. Call from `loop()` only.
+    void enqueue();
+
     /// @brief Intrusive list pointer to next control, used for update/init purposes.
     _ControlBase *next;
 
+private:
+    /// @brief Set while this control waits in the change queue, so it's never in there twice.
+    volatile bool queued = false;
+
+    /// @brief Stable ID and full path, once registered with the `ControlRegistry`.
+    uint32_t _id = 0;
+    const char *_path = nullptr;
+
+    friend void apply_queued_controls();
+    friend void run_all_control_updates();
+    friend class ControlRegistry;
+
 public:
     _ControlBase* nextControl() {
         return next;
     }
 
+    /// @brief ID for presets and remote control, 0 until registered.
+    uint32_t id() const { return _id; }
+
+    /// @brief Path in the registry, like "va/filter/cutoff", or nullptr until registered.
+    const char *path() const { return _path; }
+
     virtual void doUpdate() = 0;
+
+    /// @brief The current value, for a preset.
+    virtual ControlValue save() const = 0;
+
+    /// @brief Set the value from a preset, converting it if it was saved as another type.
+    /// Queued like any other `set()`.
+    virtual void load(ControlValue const& v) = 0;
 };
 
 /// The first control.
 _ControlBase* get_first_control();
 
-/// @brief Run updates on all dirty controls.
+/// @brief Queue every dirty control. At startup that's all of them.
 void run_all_control_updates();
 
+/// @brief Run the update functions of every queued control, oldest first. `ControlSync` calls this at
+/// the start of each audio block; nothing else should while audio is running.
+void apply_queued_controls();
+
+/// @brief Holds queued changes back from the audio interrupt while it exists, so every `set()` made
+/// meanwhile lands in the same block once it's gone. Use from `loop()`, and keep it short: held
+/// controls don't change at all.
+class ControlBatch {
+public:
+    ControlBatch();
+    ~ControlBatch();
+
+    ControlBatch(ControlBatch const&) = delete;
+    ControlBatch& operator=(ControlBatch const&) = delete;
+};
+
+/// @brief Applies queued Control changes, then advances smoothed parameters, at the start of every
+/// audio block. Make exactly one, before any other audio object, so it's first in the update list.
+class ControlSync : public AudioStream {
+public:
+    ControlSync() : AudioStream(0, nullptr) {
+        active = true; // nothing connects to us, which is what would normally set this.
+    }
+
+    virtual void update() override {
+        apply_queued_controls();
+        dezip::advance_all();
+    }
+};
+
+
+/// @brief A Control's update function: a function pointer and one pointer's worth of context, stored
+/// in place. Never allocates, and calling it is a single indirect call.
+///
+/// Takes any callable that fits in a pointer and can be copied bytewise, which covers plain
+/// functions, captureless lambdas, and lambdas capturing `this` or one reference.
+template <typename Arg>
+class ControlCallback {
+    using invoker = void (*)(const void *context, Arg const&);
+
+    alignas(void *) unsigned char context[sizeof(void *)];
+    invoker invoke = nullptr;
+
+public:
+    ControlCallback() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, ControlCallback>>>
+    ControlCallback(F f) {
+        static_assert(sizeof(F) <= sizeof(context) && alignof(F) <= alignof(void *), "Capture at most one pointer, e.g. [this].");
+        static_assert(std::is_trivially_copyable_v<F> && std::is_trivially_destructible_v<F>, "Captures must be trivially copyable.");
+
+        new (context) F(f);
+        invoke = [](const void *c, Arg const& v) { (*static_cast<const F *>(c))(v); };
+    }
+
+    explicit operator bool() const { return invoke != nullptr; }
+
+    void operator()(Arg const& v) const { invoke(context, v); }
+};
 
 /**
  * This class is intended to keep the controls of a synthesizer in sync across multiple different
  * input methods. The Control itself is owned by the synth module and stores the state of the 
  * control value. Additionally, an on-update function may be defined to actually carry out the 
  * change to runtime parameters based on these controls.
+ *
+ * Setting a control only queues it; the update function runs from the audio interrupt at the start
+ * of the next block, before any audio object updates, so it never races one.
 */
 template <typename VALTYPE>
 class Control : public _ControlBase {
 public:
     using valtype = VALTYPE;
 
-    using update_function = std::function<void(valtype const&)>;
+    using update_function = ControlCallback<valtype>;
 
     using limits_t = std::tuple<valtype, valtype>;
 
+    static_assert(sizeof(valtype) <= sizeof(uint32_t), "Control values are read by the audio interrupt, so they must be written in one store.");
+
 private:
     /// @brief Human-readable name for this control.
     const char* _name;
@@ -57,11 +167,14 @@ private:
     /// @brief A flag used to indicate that this control has changed. Starts true for initialization purposes.
     bool _dirty = true;
 
-    /// @brief Update function.
-    std::optional<update_function> onUpdate;
+    /// @brief Are `lower` and `upper` in force?
+    bool limited = false;
+
+    /// @brief Update function, if there is one.
+    update_function onUpdate;
 
     /// @brief Limits for the value.
-    std::optional<limits_t> limits;
+    valtype lower {}, upper {};
 
 public:
 
@@ -71,7 +184,7 @@ public:
         register_new_control(this);
     }
 
-    /// @brief Construct a Control with an update function called when this Control is dirty and `doUpdate()` is called on it.
+    /// @brief Construct a Control with an update function, called from the audio interrupt when this Control has changed.
     /// @param initialValue the initial value for the control to take on.
     /// @param onUpdate called with the updated value
     Control(const char* name, valtype const& initialValue, update_function onUpdate) : _name(name), initialValue(initialValue), value(initialValue), onUpdate(onUpdate) {
@@ -79,12 +192,12 @@ public:
     }
 
     /// @brief Construct a Control with an update function and numerical limits.
-    Control(const char* name, valtype const& initialValue, std::tuple<valtype, valtype> const& limits) : _name(name), initialValue(initialValue), value(initialValue), onUpdate(), limits(limits) {
+    Control(const char* name, valtype const& initialValue, limits_t const& limits) : _name(name), initialValue(initialValue), value(initialValue), limited(true), lower(std::get<0>(limits)), upper(std::get<1>(limits)) {
         register_new_control(this);
     }
     
     /// @brief Construct a Control with an update function and numerical limits.
-    Control(const char* name, valtype const& initialValue, std::tuple<valtype, valtype> const& limits, update_function onUpdate) : _name(name), initialValue(initialValue), value(initialValue), onUpdate(onUpdate), limits(limits) {
+    Control(const char* name, valtype const& initialValue, limits_t const& limits, update_function onUpdate) : _name(name), initialValue(initialValue), value(initialValue), limited(true), onUpdate(onUpdate), lower(std::get<0>(limits)), upper(std::get<1>(limits)) {
         register_new_control(this);
     }
 
@@ -122,28 +235,70 @@ public:
     virtual void doUpdate() override {
         if (!_dirty) return;
         if (onUpdate) 
-            onUpdate.value()(value);
+            onUpdate(value);
         wash();
     }
 
-    /// @brief Set the value.
+    virtual ControlValue save() const override {
+        ControlValue v {};
+        if constexpr (std::is_floating_point_v<valtype>) {
+            const float f = value;
+            v.type = ControlValue::Float;
+            std::memcpy(&v.bits, &f, sizeof(f));
+        }
+        else if constexpr (std::is_signed_v<valtype>) {
+            v.type = ControlValue::Signed;
+            v.bits = (uint32_t) (int32_t) value;
+        }
+        else {
+            v.type = ControlValue::Unsigned;
+            v.bits = (uint32_t) value;
+        }
+        return v;
+    }
+
+    virtual void load(ControlValue const& v) override {
+        switch (v.type) {
+        case ControlValue::Float: {
+            float f;
+            std::memcpy(&f, &v.bits, sizeof(f));
+            if (std::isnan(f)) return;
+            if constexpr (std::is_floating_point_v<valtype>) set(f);
+            else set(saturate(std::llround(std::clamp<double>(f, std::numeric_limits<valtype>::lowest(), std::numeric_limits<valtype>::max()))));
+            break;
+        }
+        case ControlValue::Signed:
+            set(saturate((int32_t) v.bits));
+            break;
+        case ControlValue::Unsigned:
+            set(saturate(v.bits));
+            break;
+        default:
+            break; // a type from a newer format; leave the control alone.
+        }
+    }
+
+    /// @brief Convert a loaded integer to `valtype`, saturating instead of wrapping. `set()` applies
+    /// the control's own limits after.
+    static valtype saturate(int64_t i) {
+        if constexpr (std::is_floating_point_v<valtype>) return (valtype) i;
+        else return (valtype) std::clamp<int64_t>(i, std::numeric_limits<valtype>::lowest(), std::numeric_limits<valtype>::max());
+    }
+
+    /// @brief Set the value. The update function sees it at the start of the next audio block.
     /// @param v the new value
     void set(valtype const& v) {
-        using std::get;
-
         if (v == value) return; // same value, so don't dirty ourselves just bail.
 
-        if (limits) { // we're limited, so limit it.
-            value = em::clamp(get<0>(limits.value()), v, get<1>(limits.value()));
+        if (limited) { // we're limited, so limit it.
+            value = em::clamp(lower, v, upper);
         }
         else {
             value = v;
         }
 
         _dirty = true;
-
-        // TODO move this to a separate update step!
-        doUpdate();
+        enqueue();
     }
 
     /// @brief Get the current value.
@@ -0,0 +1,114 @@
+#include "ControlRegistry.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace audio {
+
+ControlRegistry::Group::Group(ControlRegistry &registry, const char *path) : registry(registry) {
+    strncpy(prefix, path, sizeof(prefix) - 1);
+    prefix[sizeof(prefix) - 1] = 0;
+}
+
+ControlRegistry::Group ControlRegistry::Group::group(const char *name) const {
+    Group child(registry, prefix);
+    const size_t used = strlen(child.prefix);
+    snprintf(child.prefix + used, sizeof(child.prefix) - used, "/%s", name);
+    return child;
+}
+
+bool ControlRegistry::Group::add(const char *name, _ControlBase &control) const {
+    char path[sizeof(prefix) + 24];
+    snprintf(path, sizeof(path), "%s/%s", prefix, name);
+    return registry.add(path, control);
+}
+
+bool ControlRegistry::add(const char *path, _ControlBase &control) {
+    const uint32_t id = control_id(path);
+    const int length = strlen(path) + 1;
+
+    if (count >= capacity || pathsUsed + length > (int) paths.size()) {
+        Serial.printf("Control registry is full, can't add %s.\n", path);
+        return false;
+    }
+    // 0 means unregistered, so it can't be an ID. This only happens at startup, so just scan.
+    const bool taken = std::any_of(entries.begin(), entries.begin() + count, [id](Entry const& e) { return e.id == id; });
+    if (id == 0 || taken) {
+        Serial.printf("Control path %s is taken, or its ID collides with another.\n", path);
+        return false;
+    }
+
+    char *stored = &paths[pathsUsed];
+    memcpy(stored, path, length);
+    pathsUsed += length;
+
+    entries[count++] = Entry {id, stored, &control};
+    control._id = id;
+    control._path = stored;
+    built = false;
+    return true;
+}
+
+bool ControlRegistry::build() {
+    int bits = 1;
+    while ((1 << bits) < count * 4) bits++;
+
+    // a random multiply scatters well, so with a table 4x the entries a few tries usually do it.
+    for (; bits <= max_slot_bits; bits++) {
+        uint32_t candidate = 0x9E3779B9u;
+        for (int attempt = 0; attempt < 256; attempt++) {
+            candidate = (candidate * 1664525u + 1013904223u) | 1;
+
+            multiplier = candidate;
+            slotBits = bits;
+            std::fill(slots.begin(), slots.begin() + (1 << bits), 0);
+
+            bool distinct = true;
+            for (int i = 0; i < count && distinct; i++) {
+                auto &s = slots[slot(entries[i].id)];
+                distinct = (s == 0);
+                s = i + 1;
+            }
+
+            if (distinct) {
+                built = true;
+                return true;
+            }
+        }
+    }
+
+    Serial.println("Couldn't build a perfect hash of the control IDs.");
+    slotBits = 0;
+    return false;
+}
+
+_ControlBase *ControlRegistry::find(uint32_t id) {
+    if (count == 0) return nullptr;
+    if (!built && !build()) {
+        // not reachable in practice, but keep working if it ever happens.
+        for (int i = 0; i < count; i++) {
+            if (entries[i].id == id) return entries[i].control;
+        }
+        return nullptr;
+    }
+
+    const int index = slots[slot(id)];
+    if (index == 0 || entries[index - 1].id != id) return nullptr;
+    return entries[index - 1].control;
+}
+
+int ControlRegistry::unregistered() const {
+    int missing = 0;
+    for (auto control = get_first_control(); control; control = control->nextControl()) {
+        if (!control->path()) missing++;
+    }
+    return missing;
+}
+
+ControlRegistry& control_registry() {
+    static ControlRegistry registry;
+    return registry;
+}
+
+}
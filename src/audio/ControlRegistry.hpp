@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "Control.hpp"
+
+/// @brief Most controls the registry can hold. Must stay under 256.
+#ifndef CONTROL_REGISTRY_SIZE
+#define CONTROL_REGISTRY_SIZE 128
+#endif
+
+/// @brief Bytes set aside for the registered paths, nul terminators included.
+#ifndef CONTROL_REGISTRY_PATH_BYTES
+#define CONTROL_REGISTRY_PATH_BYTES 2048
+#endif
+
+namespace audio {
+
+/// @brief The stable ID of a control path: its 32-bit FNV-1a hash. Doesn't depend on declaration
+/// order or anything else in the build, so it's safe to store in presets and MIDI maps.
+/// `constexpr`, so lookups by a literal path do no string work at runtime.
+constexpr uint32_t control_id(const char *path) {
+    uint32_t hash = 2166136261u;
+    while (*path) {
+        hash = (hash ^ (uint8_t) *path++) * 16777619u;
+    }
+    return hash;
+}
+
+/// @brief Finds controls by hierarchical path, like "va/osc1/type", or by ID, in constant time.
+///
+/// Modules register their controls at startup through `Group`s. The first lookup after that builds
+/// a perfect hash of the IDs: one multiply picks a slot, and no two controls share one. Register
+/// and look up from `loop()`, not the audio interrupt.
+class ControlRegistry {
+public:
+    static constexpr int capacity = CONTROL_REGISTRY_SIZE;
+    static_assert(capacity < 256, "Slots hold an 8-bit index.");
+
+    struct Entry {
+        uint32_t id;
+        const char *path;
+        _ControlBase *control;
+    };
+
+    /// @brief A level of the path hierarchy.
+    class Group {
+        ControlRegistry &registry;
+        char prefix[48];
+
+    public:
+        Group(ControlRegistry &registry, const char *path);
+
+        /// @brief A group nested in this one.
+        Group group(const char *name) const;
+
+        /// @brief Register a control as `name` in this group.
+        /// @return false if the path's taken, its ID collides with another, or the registry is full
+        bool add(const char *name, _ControlBase &control) const;
+    };
+
+private:
+    /// @brief Slot tables go up to 2^max_slot_bits entries before giving up.
+    static constexpr int max_slot_bits = 10;
+
+    std::array<Entry, capacity> entries;
+    int count = 0;
+
+    std::array<char, CONTROL_REGISTRY_PATH_BYTES> paths;
+    int pathsUsed = 0;
+
+    /// @brief The perfect hash: entry index + 1 for each slot, 0 for empty.
+    std::array<uint8_t, 1 << max_slot_bits> slots;
+    uint32_t multiplier = 0;
+    int slotBits = 0;
+    bool built = false;
+
+    int slot(uint32_t id) const { return (uint32_t) (id * multiplier) >> (32 - slotBits); }
+
+    bool add(const char *path, _ControlBase &control);
+
+public:
+    /// @brief A top-level group.
+    Group group(const char *name) { return Group(*this, name); }
+
+    /// @brief Search for a multiplier that spreads the registered IDs into distinct slots.
+    /// Lookups do this themselves the first time after a registration.
+    /// @return false if none was found, which would take a lot of controls.
+    bool build();
+
+    /// @brief Find a control by ID.
+    /// @return the control, or nullptr if nothing has that ID.
+    _ControlBase *find(uint32_t id);
+
+    /// @brief Find a control by path. Prefer `find(control_id("..."))` with a literal.
+    _ControlBase *find(const char *path) { return find(control_id(path)); }
+
+    /// @brief Count the constructed controls that were never registered.
+    int unregistered() const;
+
+    int size() const { return count; }
+    Entry const *begin() const { return entries.data(); }
+    Entry const *end() const { return entries.data() + count; }
+};
+
+/// @brief The registry every module adds its controls to.
+ControlRegistry& control_registry();
+
+}
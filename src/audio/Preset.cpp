@@ -0,0 +1,179 @@
+#include "Preset.hpp"
+
+namespace audio {
+
+namespace {
+
+/// @brief Header and section header sizes, as stored.
+constexpr size_t header_bytes = 8;
+constexpr size_t section_header_bytes = 8;
+
+}
+
+
+PresetWriter::PresetWriter(PresetSink &sink) : sink(sink) {
+    put(preset::magic, sizeof(preset::magic));
+    put<uint16_t>(preset::version);
+    put<uint16_t>(0);
+}
+
+
+void PresetWriter::put(const void *data, size_t size) {
+    auto *from = (const uint8_t *) data;
+    while (size) {
+        if (buffered == sizeof(buffer)) {
+            failed |= sink.write(buffer, buffered) != buffered;
+            buffered = 0;
+        }
+
+        const size_t n = std::min(size, sizeof(buffer) - buffered);
+        std::memcpy(buffer + buffered, from, n);
+        buffered += n;
+        from += n;
+        size -= n;
+    }
+}
+
+
+void PresetWriter::section(preset::Section kind, uint8_t flags, uint32_t bytes) {
+    put<uint8_t>((uint8_t) kind);
+    put<uint8_t>(flags);
+    put<uint16_t>(0);
+    put<uint32_t>(bytes);
+}
+
+
+void PresetWriter::controls(ControlRegistry const& registry) {
+    section(preset::Section::Controls, 0, 2 + registry.size() * preset::control_bytes);
+    put<uint16_t>(registry.size());
+
+    for (auto const& entry : registry) {
+        const ControlValue v = entry.control->save();
+        put<uint32_t>(entry.id);
+        put<uint8_t>(v.type);
+        put<uint32_t>(v.bits);
+    }
+}
+
+
+bool PresetWriter::finish() {
+    if (buffered) {
+        failed |= sink.write(buffer, buffered) != buffered;
+        buffered = 0;
+    }
+    return !failed;
+}
+
+
+PresetReader::PresetReader(PresetSource &source) : source(source) {
+    uint8_t header[header_bytes];
+    if (!fetch(header, sizeof(header)) || std::memcmp(header, preset::magic, sizeof(preset::magic)) != 0) {
+        failed = true;
+        return;
+    }
+
+    std::memcpy(&_version, header + 4, sizeof(_version));
+
+    // a newer version is free to change what's already there; only new sections are safe to skip.
+    if (_version > preset::version) failed = true;
+}
+
+
+bool PresetReader::fetch(void *data, size_t size) {
+    auto *to = (uint8_t *) data;
+    while (size) {
+        if (position == buffered) {
+            position = 0;
+            buffered = source.read(buffer, sizeof(buffer));
+            if (!buffered) return false;
+        }
+
+        const size_t n = std::min(size, buffered - position);
+        std::memcpy(to, buffer + position, n);
+        position += n;
+        to += n;
+        size -= n;
+    }
+    return true;
+}
+
+
+bool PresetReader::get(void *data, size_t size) {
+    if (failed || size > remaining || !fetch(data, size)) {
+        // everything after a short read is garbage, so stop there.
+        std::memset(data, 0, size);
+        failed = true;
+        return false;
+    }
+
+    remaining -= size;
+    return true;
+}
+
+
+void PresetReader::skip(uint32_t size) {
+    uint8_t scratch[64];
+    while (size && !failed) {
+        const uint32_t n = std::min<uint32_t>(size, sizeof(scratch));
+        get(scratch, n);
+        size -= n;
+    }
+}
+
+
+bool PresetReader::next(Section &section) {
+    skip(remaining);
+    if (failed) return false;
+
+    if (position == buffered) {
+        position = 0;
+        buffered = source.read(buffer, sizeof(buffer));
+        if (!buffered) return false; // the end of the preset
+    }
+
+    // but running out partway through a section header means it was cut short.
+    uint8_t header[section_header_bytes];
+    if (!fetch(header, sizeof(header))) {
+        failed = true;
+        return false;
+    }
+
+    current.kind = (preset::Section) header[0];
+    current.flags = header[1];
+    std::memcpy(&current.bytes, header + 4, sizeof(current.bytes));
+
+    remaining = current.bytes;
+    section = current;
+    return true;
+}
+
+
+void StagedControls::apply() const {
+    for (int i = 0; i < count; i++) {
+        entries[i].control->load(entries[i].value);
+    }
+}
+
+
+int PresetReader::controls(ControlRegistry &registry, StagedControls &staged) {
+    const int count = get<uint16_t>();
+
+    int loaded = 0;
+    for (int i = 0; i < count && !failed; i++) {
+        const uint32_t id = get<uint32_t>();
+        ControlValue v;
+        v.type = get<uint8_t>();
+        v.bits = get<uint32_t>();
+
+        if (failed) break;
+        auto *control = registry.find(id);
+        if (control && staged.count < (int) staged.entries.size()) {
+            staged.entries[staged.count++] = {control, v};
+            loaded++;
+        }
+    }
+
+    return loaded;
+}
+
+}
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "Control.hpp"
+#include "ControlRegistry.hpp"
+#include "../ext/Audio/synth_additive.h"
+
+/// @brief Bytes the preset reader and writer stage at a time, so the file sees a few large
+/// accesses instead of one per field.
+#ifndef PRESET_BUFFER_BYTES
+#define PRESET_BUFFER_BYTES 512
+#endif
+
+namespace audio {
+
+/// Presets: every registered Control, the additive synth's partial frames, and the oscillator
+/// bank's voice envelope, in one compact binary blob. Little-endian, like the Teensy:
+///
+///     header    "TIEP", u16 version, u16 reserved
+///     section   u8 kind, u8 flags, u16 reserved, u32 payload bytes, then the payload
+///
+/// Sections follow one another to the end of the data. Readers skip kinds they don't know, and
+/// whatever's left of a section they only partly understood, so new sections and fields can be
+/// added without breaking old files. The payloads:
+///
+///     controls  u16 count, then per control: u32 ID (see `control_id()`), u8 type, u32 value
+///     frame     u8 frame, u8 reserved, u16 bins, u16 count, then `count` sparse bins as
+///               (u16 bin, f32 amplitude, f32 phase), or with `dense` in the flags, `bins`
+///               amplitudes followed by `bins` phases
+///     envelope  u16 values, u16 points, then per point: i32 t, f32 a[values]
+namespace preset {
+
+constexpr uint8_t magic[4] = {'T', 'I', 'E', 'P'};
+constexpr uint16_t version = 1;
+
+enum class Section : uint8_t {
+    Controls = 1,
+    Frame = 2,
+    Envelope = 3,
+};
+
+/// @brief Frame section flag: every bin is stored, rather than just the non-zero ones.
+constexpr uint8_t dense = 1;
+
+/// @brief Bytes per stored control and per sparse bin.
+constexpr uint32_t control_bytes = 9;
+constexpr uint32_t sparse_bin_bytes = 10;
+
+}
+
+/// @brief Where a preset is written to.
+class PresetSink {
+public:
+    virtual ~PresetSink() {}
+
+    /// @return the number of bytes written, less than `size` on error
+    virtual size_t write(const void *data, size_t size) = 0;
+};
+
+/// @brief Where a preset is read from.
+class PresetSource {
+public:
+    virtual ~PresetSource() {}
+
+    /// @return the number of bytes read, less than `size` at the end of the data
+    virtual size_t read(void *data, size_t size) = 0;
+};
+
+/// @brief A preset held in memory, for timing and for checking the format off the device.
+class MemoryPreset : public PresetSink, public PresetSource {
+    uint8_t *data;
+    size_t capacity;
+    size_t used;
+    size_t position = 0;
+
+public:
+    /// @param data storage for the preset
+    /// @param capacity bytes of storage
+    /// @param used bytes of `data` that already hold a preset to read
+    MemoryPreset(uint8_t *data, size_t capacity, size_t used = 0) : data(data), capacity(capacity), used(used) {}
+
+    virtual size_t write(const void *from, size_t size) override {
+        size = std::min(size, capacity - used);
+        std::memcpy(data + used, from, size);
+        used += size;
+        return size;
+    }
+
+    virtual size_t read(void *to, size_t size) override {
+        size = std::min(size, used - position);
+        std::memcpy(to, data + position, size);
+        position += size;
+        return size;
+    }
+
+    /// @brief Read again from the start.
+    void rewind() { position = 0; }
+
+    size_t size() const { return used; }
+};
+
+/// @brief Control values read from a preset, held until they're applied.
+struct StagedControls {
+    struct Entry {
+        _ControlBase *control;
+        ControlValue value;
+    };
+
+    std::array<Entry, ControlRegistry::capacity> entries;
+    int count = 0;
+
+    /// @brief `load()` every staged value, in the order they were read. Hold a `ControlBatch` to
+    /// land them all in the same block.
+    void apply() const;
+};
+
+/// @brief Writes a preset, one section at a time.
+class PresetWriter {
+    PresetSink &sink;
+    uint8_t buffer[PRESET_BUFFER_BYTES];
+    size_t buffered = 0;
+    bool failed = false;
+
+    void put(const void *data, size_t size);
+
+    template <typename T>
+    void put(T v) { put(&v, sizeof(v)); }
+
+    void section(preset::Section kind, uint8_t flags, uint32_t bytes);
+
+public:
+    /// @brief Start a preset by writing its header.
+    explicit PresetWriter(PresetSink &sink);
+
+    /// @brief Write every registered control's value.
+    void controls(ControlRegistry const& registry);
+
+    /// @brief Write one frame of partials, storing only the non-zero bins if that's smaller.
+    template <int Bins>
+    void frame(int index, additive::PolarPartials<Bins> const& partials) {
+        int count = 0;
+        for (int i = 0; i < Bins; i++) {
+            if (partials.amplitude[i] != 0) count++;
+        }
+
+        const bool isDense = count * preset::sparse_bin_bytes >= Bins * 8u;
+        section(preset::Section::Frame, isDense ? preset::dense : 0, 6 + (isDense ? Bins * 8 : count * preset::sparse_bin_bytes));
+
+        put<uint8_t>(index);
+        put<uint8_t>(0);
+        put<uint16_t>(Bins);
+        put<uint16_t>(isDense ? Bins : count);
+
+        if (isDense) {
+            put(partials.amplitude.data(), sizeof(float) * Bins);
+            put(partials.phase.data(), sizeof(float) * Bins);
+            return;
+        }
+
+        for (int i = 0; i < Bins; i++) {
+            if (partials.amplitude[i] == 0) continue;
+            put<uint16_t>(i);
+            put(partials.amplitude[i]);
+            put(partials.phase[i]);
+        }
+    }
+
+    /// @brief Write an envelope's control points.
+    template <int N, int M>
+    void envelope(SequenceInterpolator<N, M> const& env) {
+        section(preset::Section::Envelope, 0, 4 + M * (4 + N * sizeof(float)));
+        put<uint16_t>(N);
+        put<uint16_t>(M);
+        for (int i = 0; i < M; i++) {
+            put<int32_t>(env[i].t);
+            put(env[i].a, sizeof(float) * N);
+        }
+    }
+
+    /// @brief Write out whatever's still buffered.
+    /// @return true if the whole preset made it to the sink
+    bool finish();
+};
+
+/// @brief Reads a preset back, one section at a time.
+///
+/// Check `valid()`, then call `next()` for each section and hand it to the matching reader.
+/// Anything a reader doesn't consume is skipped by the following `next()`.
+class PresetReader {
+public:
+    struct Section {
+        preset::Section kind;
+        uint8_t flags;
+        uint32_t bytes;
+    };
+
+private:
+    PresetSource &source;
+    uint8_t buffer[PRESET_BUFFER_BYTES];
+    size_t position = 0, buffered = 0;
+
+    /// @brief The section being read, and how much of its payload is left.
+    Section current {};
+    uint32_t remaining = 0;
+
+    uint16_t _version = 0;
+    bool failed = false;
+
+    /// @brief Read straight from the source, ignoring section bounds.
+    bool fetch(void *data, size_t size);
+
+    /// @brief Read from the current section.
+    bool get(void *data, size_t size);
+
+    template <typename T>
+    T get() {
+        T v {};
+        get(&v, sizeof(v));
+        return v;
+    }
+
+    /// @brief Pass over bytes of the current section.
+    void skip(uint32_t size);
+
+public:
+    /// @brief Start reading a preset by checking its header.
+    explicit PresetReader(PresetSource &source);
+
+    /// @brief Header was good, and nothing's been cut short since.
+    bool valid() const { return !failed; }
+
+    uint16_t version() const { return _version; }
+
+    /// @brief Move on to the next section.
+    /// @return false at the end of the preset, or if it's damaged
+    bool next(Section &section);
+
+    /// @brief Read a controls section into `staged`, to be applied later.
+    /// @return the number of controls staged. IDs that aren't registered are passed over, as are
+    /// any once `staged` is full.
+    int controls(ControlRegistry &registry, StagedControls &staged);
+
+    /// @brief Load a frame section. It's read into `scratch`, and copied over the table only once
+    /// it's all there, so a section that's cut short leaves the table as it was. Bins the preset
+    /// doesn't mention are cleared, and ones past the end of the table dropped.
+    /// @param partialsFor called with the frame index; returns the `PolarPartials` to fill, or
+    /// nullptr to pass over the frame
+    /// @param scratch somewhere to read the section to, the same size as the tables
+    /// @return the frame index, or -1 if it was passed over or cut short
+    template <typename Partials, typename Lookup>
+    int frame(Lookup &&partialsFor, Partials &scratch) {
+        const int index = get<uint8_t>();
+        get<uint8_t>();
+        const int bins = get<uint16_t>();
+        const int count = get<uint16_t>();
+
+        Partials *partials = failed ? nullptr : partialsFor(index);
+        if (!partials) return -1;
+
+        constexpr int tableBins = Partials::bins;
+        scratch.amplitude.fill(0);
+        scratch.phase.fill(0);
+
+        if (current.flags & preset::dense) {
+            const int kept = std::min(bins, tableBins);
+            get(scratch.amplitude.data(), sizeof(float) * kept);
+            skip(sizeof(float) * (bins - kept));
+            get(scratch.phase.data(), sizeof(float) * kept);
+            skip(sizeof(float) * (bins - kept));
+        }
+        else {
+            for (int i = 0; i < count && !failed; i++) {
+                const int bin = get<uint16_t>();
+                const float a = get<float>();
+                const float p = get<float>();
+                if (bin >= tableBins) continue;
+                scratch.amplitude[bin] = a;
+                scratch.phase[bin] = p;
+            }
+        }
+
+        if (failed) return -1;
+
+        partials->amplitude = scratch.amplitude;
+        partials->phase = scratch.phase;
+        partials->touch(0, tableBins);
+        return index;
+    }
+
+    /// @brief Load an envelope section. Points and values the envelope doesn't have room for are
+    /// dropped, and ones the preset doesn't have are left alone. Nothing changes if it's cut short.
+    /// @return false if it was cut short
+    template <int N, int M>
+    bool envelope(SequenceInterpolator<N, M> &env) {
+        // a handful of points, so they're staged on the stack.
+        std::array<ControlPoint<N>, M> points;
+        for (int i = 0; i < M; i++) points[i] = env[i];
+
+        const int values = get<uint16_t>();
+        const int count = get<uint16_t>();
+        const int kept = std::min(values, N);
+
+        for (int i = 0; i < count && !failed; i++) {
+            const int32_t t = get<int32_t>();
+            if (i >= M) {
+                skip(sizeof(float) * values);
+                continue;
+            }
+
+            points[i].t = t;
+            get(points[i].a, sizeof(float) * kept);
+            skip(sizeof(float) * (values - kept));
+        }
+
+        if (failed) return false;
+
+        for (int i = 0; i < M; i++) env[i] = points[i];
+        return true;
+    }
+};
+
+/// @brief Write every registered Control, the additive frames, and the oscillator bank's voice.
+/// @return true if it was all written
+bool write_preset(PresetSink &sink);
+
+/// @brief Load a preset written by `write_preset()`. Call from `loop()`.
+///
+/// The whole preset is read before anything is heard, then published in one go. Frames and the
+/// voice go into the editing copies as each of their sections is read in full; one that's cut
+/// short is dropped, and its editing copy left as it was.
+///
+/// Controls all change in the same audio block. The voice envelope swaps in at the start of that
+/// block too, or of the one before if a block starts while publishing. Frames can't keep up:
+/// `service()` renders one per `loop()` and each crossfades in as after an edit, so for a few
+/// `loop()`s some frames are from the old preset and some from the new.
+/// @return false if the preset was missing or damaged. Sections before the damage still load.
+bool read_preset(PresetSource &source);
+
+/// @brief `write_preset()` to a file on the SD card, replacing it.
+bool save_preset(const char *path);
+
+/// @brief `read_preset()` from a file on the SD card.
+bool load_preset(const char *path);
+
+}
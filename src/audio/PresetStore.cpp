@@ -0,0 +1,154 @@
+#include "Preset.hpp"
+#include "audio_externs.h"
+#include "additive/Analyzer.hpp"
+#include <memory>
+#include <new>
+
+// The synth's presets and where they're kept. The format is Preset.cpp's business.
+
+namespace audio {
+
+namespace {
+
+/// @brief A file on the SD card as a preset sink or source.
+class FilePreset : public PresetSink, public PresetSource {
+    File &file;
+
+public:
+    explicit FilePreset(File &file) : file(file) {}
+
+    virtual size_t write(const void *data, size_t size) override {
+        return file.write((const uint8_t *) data, size);
+    }
+
+    virtual size_t read(void *data, size_t size) override {
+        const int n = file.read(data, size);
+        return n > 0 ? n : 0;
+    }
+};
+
+}
+
+
+bool write_preset(PresetSink &sink) {
+    PresetWriter writer(sink);
+    writer.controls(control_registry());
+
+    for (int i = 0; i < AudioSynthAdditive::n_frames; i++) {
+        if (auto *partials = additive1.partials(i)) writer.frame(i, *partials);
+    }
+
+    writer.envelope(oscbank1.getVoice());
+    return writer.finish();
+}
+
+
+bool read_preset(PresetSource &source) {
+    PresetReader reader(source);
+    if (!reader.valid()) return false;
+
+    // frames are read here before they're copied over the editing ones. 16 KB, so it's only
+    // around while loading.
+    std::unique_ptr<AudioSynthAdditive::Partials> scratch(new (std::nothrow) AudioSynthAdditive::Partials);
+    if (!scratch) {
+        Serial.println("No memory to load a preset.");
+        return false;
+    }
+
+    // read everything first. The frames and the voice go into the editing copies, which the audio
+    // doesn't see until they're published, and the controls are held back.
+    StagedControls controls;
+    bool framesLoaded[AudioSynthAdditive::n_frames] {};
+    bool voiceLoaded = false;
+
+    PresetReader::Section section;
+    while (reader.next(section)) {
+        switch (section.kind) {
+        case preset::Section::Controls:
+            reader.controls(control_registry(), controls);
+            break;
+
+        case preset::Section::Frame: {
+            const int frame = reader.frame([](int i) {
+                return i < AudioSynthAdditive::n_frames ? additive1.partials(i) : nullptr;
+            }, *scratch);
+            if (frame >= 0) framesLoaded[frame] = true;
+            break;
+        }
+
+        case preset::Section::Envelope:
+            voiceLoaded |= reader.envelope(oscbank1.getVoice());
+            break;
+
+        default:
+            break; // from a newer version, so `next()` passes over it.
+        }
+    }
+
+    // then publish it all at once, so the batch is only held for as long as that takes.
+    {
+        ControlBatch batch;
+        controls.apply();
+
+        if (voiceLoaded) {
+            oscbank1.voiceChanged();
+            oscbank1.service();
+        }
+
+        for (int i = 0; i < AudioSynthAdditive::n_frames; i++) {
+            if (framesLoaded[i]) additive1.partialsChanged(i);
+        }
+    }
+
+    return reader.valid();
+}
+
+
+bool save_preset(const char *path) {
+    initialize_sd();
+    if (!sd_ready()) {
+        Serial.println("No SD card inserted.");
+        return false;
+    }
+
+    // FILE_WRITE appends, so start from nothing.
+    if (SD.exists(path)) SD.remove(path);
+
+    File file = SD.open(path, FILE_WRITE);
+    if (!file) {
+        Serial.println("Preset cannot be written.");
+        return false;
+    }
+
+    FilePreset sink(file);
+    const bool ok = write_preset(sink);
+    file.close();
+
+    if (!ok) Serial.println("Preset was cut short.");
+    return ok;
+}
+
+
+bool load_preset(const char *path) {
+    initialize_sd();
+    if (!sd_ready()) {
+        Serial.println("No SD card inserted.");
+        return false;
+    }
+
+    File file = SD.open(path);
+    if (!file) {
+        Serial.println("Preset cannot be opened.");
+        return false;
+    }
+
+    const uint32_t start = micros();
+    FilePreset source(file);
+    const bool ok = read_preset(source);
+    file.close();
+
+    Serial.printf("Loaded preset %s in %d us%s.\n", path, (int) (micros() - start), ok ? "" : ", but it's damaged");
+    return ok;
+}
+
+}
@@ -3,15 +3,55 @@
 namespace audio {
 
 void AdditiveSynth::doSetup() {
-    analyzer.loadFromSD("a.wav");
+    if (!additive1.partials()) {
+        Serial.printf("No memory for the additive wavetable (%d KB); it'll stay silent.\n", (int) (sizeof(AudioSynthAdditive::Wavetable) / 1024));
+    }
+    else if (analyzer.loadFromSD("a.wav")) {
+        analyzer.analyze(additive1);
+    }
+
+    auto add = control_registry().group("additive");
+    auto mix = add.group("mix");
+    mix.add("spectral", spectralMix);
+    mix.add("banks", banksMix);
+
+    add.group("banks").add("stealing", stealing);
+
+    auto env = add.group("env");
+    env.add("attack", attack);
+    env.add("release", release);
+
+    add.add("scan", scan);
+    add.add("frame", frame);
+
+    auto grains = add.group("grains");
+    grains.add("density", grainDensity);
+    grains.add("length", grainLength);
+    grains.add("pitch", grainPitch);
+    grains.add("spread", grainSpread);
+    grains.add("pan", grainPan);
+
+    add.add("debug", debug);
+}
+
+void AdditiveSynth::updateGrains() {
+    AudioSynthAdditive::GrainParams params;
+    params.density = *grainDensity;
+    params.durationMs = *grainLength;
+    params.ratio = *grainPitch;
+    params.ratioSpread = *grainSpread;
+    params.panSpread = *grainPan;
+    additive1.grains(params);
 }
 
 void AdditiveSynth::noteOn(NoteNumber note, float velocity){
-    frequency.set(NoteFreqs[note]);
+    additive1.noteOn(note, NoteFreqs[note], velocity);
+    oscbank1.noteOn(note, NoteFreqs[note]);
 }
 
 void AdditiveSynth::noteOff(NoteNumber note, float velocity){
-
+    additive1.noteOff(note);
+    oscbank1.noteOff(note);
 }
 
 void AdditiveSynth::controlChange(CCNumber cc, byte value){
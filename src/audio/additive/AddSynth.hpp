@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Control.hpp"
+#include "../ControlRegistry.hpp"
 #include "Arduino.h"
 #include "../audio_externs.h"
 #include "Analyzer.hpp"
@@ -12,19 +13,51 @@ struct AdditiveSynth : public Synth {
     Control<float> spectralMix {"Mix.Spect", 0, {0, 2}, [this](float g) { add_mixer.gain(0, g); }};
     Control<float> banksMix {"Mix.Banks", 1, {0, 2}, [this](float g) { add_mixer.gain(1, g); }};
 
-    Control<float> frequency {"Freq.", 172, {1, 20000}, [this](float f) {
-        oscbank1.frequency(0, f);
-        oscbank1.setActive(0, true);
+    /// @brief How the oscillator banks are stolen: round robin, oldest, or quietest.
+    Control<int> stealing {"Steal", 0, {0, 2}, [](int s) { oscbank1.stealing((AudioSynthOscBank::Stealing) s); }};
+
+    /// @brief Envelope times for the spectral voices, in ms.
+    Control<float> attack {"Attack", 2, {0, 5000}, [this](float a) { additive1.envelope(a, *release); }};
+    Control<float> release {"Release", 50, {0, 5000}, [this](float r) {
+        additive1.envelope(*attack, r);
+        oscbank1.releaseTime(r);
     }};
 
+    /// @brief Position through the spectral frames, and the frame the partial editor works on.
+    Control<float> scan {"Scan", 0, {0, AudioSynthAdditive::n_frames - 1}, [](float s) { additive1.scan(s); }};
+    Control<int> frame {"Frame", 0, {0, AudioSynthAdditive::n_frames - 1}, [](int f) { additive1.editFrame(f); }};
+
+    /// @brief Grain cloud over the current frame. Pitch is relative to the last note, spread is in octaves.
+    Control<float> grainDensity {"Grains/s", 0, {0, 2000}, [this](float) { updateGrains(); }};
+    Control<float> grainLength {"Gr.Len", 60, {1, 2000}, [this](float) { updateGrains(); }};
+    Control<float> grainPitch {"Gr.Pitch", 1, {0.125f, 8}, [this](float) { updateGrains(); }};
+    Control<float> grainSpread {"Gr.Sprd", 0, {0, 2}, [this](float) { updateGrains(); }};
+    Control<float> grainPan {"Gr.Pan", 0, {0, 1}, [this](float) { updateGrains(); }};
+
     Control<int> debug {"Debug", 0, {0, 1}, [](int b) { oscbank1.debug(b); }};
 
     AudioAnalyzer analyzer;
 
     decltype(additive1.partials()) partials() { return additive1.partials(); }
 
+    void partialsChanged() { additive1.partialsChanged(); }
+
+    /// @brief Push the grain controls to the synth.
+    void updateGrains();
+
+    /// @brief Do background work for the synth. Call from `loop()`.
+    void service() {
+        analyzer.step();
+        additive1.service();
+        oscbank1.service();
+    }
+
     decltype(oscbank1.getVoice()) bankVoice() { return oscbank1.getVoice(); }
 
+    /// @brief Publish edits made through `bankVoice()` at the next `service()`.
+    void bankVoiceChanged() { oscbank1.voiceChanged(); }
+
+    /// @brief Load the startup analysis, and register the Controls under "additive".
     void doSetup();
 
     virtual void noteOn(NoteNumber note, float velocity) override;
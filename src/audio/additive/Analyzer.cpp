@@ -1,6 +1,7 @@
 #include "Analyzer.hpp"
 
 #include <SD.h>
+#include <algorithm>
 
 namespace audio {
 
@@ -11,6 +12,10 @@ WavReader::~WavReader() {
     file.close();
 }
 
+WavReader::Error WavReader::status() {
+    return errorState;
+}
+
 void initialize_sd() {
     if (sdInit) return;
 
@@ -108,6 +113,11 @@ WavReader::WavReader(const char* path) : file() {
     }
 
     nChannels = read_short();
+    if (nChannels < 1 || nChannels > 8) {
+        Serial.println(nChannels);
+        errorState = Error::UNSUPPORTED;
+        return;
+    }
     
     auto sampleRate = read_long();
 
@@ -132,30 +142,167 @@ WavReader::WavReader(const char* path) : file() {
 
     auto chunkSize = read_long();
     nSamples = chunkSize / (nChannels * sizeof(int16_t)); // we only support 16-bit samples, so this is "fine"
+    readIndex = 0;
 #pragma GCC diagnostic pop
 }
 
-void WavReader::readSamples(sample **buffers, uint32_t nSamples) {
-    int16_t readbuf[64];
-    int outputIndex = 0;
+uint32_t WavReader::readSamples(sample **buffers, uint32_t count) {
+    if (errorState != Error::OK) return 0;
 
-    while (nSamples) {
-        file.read((char*) readbuf, nChannels * sizeof(int16_t));
+    count = std::min(count, (uint32_t) (nSamples - readIndex));
 
-        for (int i = 0; i < nChannels; i++) {
-            if (buffers[i])
-                buffers[i][outputIndex] = readbuf[i];
+    // read as many whole sample frames as fit, rather than one SD access per frame.
+    int16_t readbuf[64];
+    const uint32_t framesPerRead = (sizeof(readbuf) / sizeof(readbuf[0])) / nChannels;
+
+    uint32_t outputIndex = 0;
+    while (outputIndex < count) {
+        const uint32_t n = std::min(framesPerRead, count - outputIndex);
+        file.read((char*) readbuf, n * nChannels * sizeof(int16_t));
+
+        for (uint32_t s = 0; s < n; s++) {
+            for (int i = 0; i < nChannels; i++) {
+                if (buffers[i])
+                    buffers[i][outputIndex + s] = readbuf[s * nChannels + i];
+            }
         }
 
-        nSamples--;
-        outputIndex++;
+        outputIndex += n;
     }
+
+    readIndex += count;
+    return count;
 }
 
 
 bool AudioAnalyzer::loadFromSD(const char* path) {
     reader = std::make_unique<WavReader>(path);
 
+    return reader->status() == WavReader::Error::OK;
+}
+
+int AudioAnalyzer::Analysis::outputHop(int k) const {
+    constexpr int nFrames = AudioSynthAdditive::n_frames;
+
+    // skip the first couple of hops when we can, so the tracks have had time to settle.
+    const int first = std::min(min_track_age, totalHops - 1);
+    if (nFrames < 2) return first;
+
+    return first + (k * (totalHops - 1 - first) + (nFrames - 1) / 2) / (nFrames - 1);
+}
+
+void AudioAnalyzer::readMono(float *out, int count) {
+    auto &a = *analysis;
+
+    sample *buffers[8] {a.left.data(), reader->channels() > 1 ? a.right.data() : nullptr};
+    const int n = reader->readSamples(buffers, count);
+
+    constexpr float scale = 1.f / 32768;
+    if (reader->channels() > 1) {
+        for (int i = 0; i < n; i++) out[i] = (a.left[i] + a.right[i]) * (0.5f * scale);
+    }
+    else {
+        for (int i = 0; i < n; i++) out[i] = a.left[i] * scale;
+    }
+    std::fill(out + n, out + count, 0.f);
+}
+
+bool AudioAnalyzer::analyze(AudioSynthAdditive &synth, float fundamental) {
+    if (!reader || reader->status() != WavReader::Error::OK) return false;
+    if (!synth.partials(0)) return false; // nowhere to put the frames
+
+    analysis = std::make_unique<Analysis>();
+    auto &a = *analysis;
+    a.synth = &synth;
+    a.fundamental = fundamental;
+    a.totalHops = std::max(1, (reader->length() - StftAnalyzer::frame_size) / hop_size + 1);
+
+    // prime the first frame a hop at a time, so we never need more than a hop of read buffer.
+    for (int i = 0; i < StftAnalyzer::frame_size; i += hop_size) {
+        readMono(a.frame.data() + i, hop_size);
+    }
+
+    return true;
+}
+
+float AudioAnalyzer::progress() const {
+    if (!analysis) return 1;
+    return (float) analysis->hop / analysis->totalHops;
+}
+
+void AudioAnalyzer::writeFrame(int k) {
+    auto &a = *analysis;
+    auto &partials = *a.synth->partials(k);
+    partials.clear();
+
+    // established tracks only, unless the file's too short for any to be established.
+    const int minAge = std::min(min_track_age, a.hop);
+
+    float loudest = 0;
+    for (int t = 0; t < a.tracker.size(); t++) {
+        if (a.tracker[t].age >= minAge) loudest = std::max(loudest, a.tracker[t].peak.amplitude);
+    }
+
+    // Each frame is a single cycle, so partials are placed as harmonics of a fundamental. Without
+    // one, take the lowest track within 30 dB of the loudest.
+    float f0 = a.fundamental;
+    for (int t = 0; t < a.tracker.size() && f0 <= 0; t++) {
+        auto const& track = a.tracker[t];
+        if (track.age >= minAge && track.peak.amplitude >= loudest * 0.0316f) f0 = track.peak.frequency;
+    }
+
+    if (f0 > 0) {
+        // a full-scale sinusoid in the synth's partial table has amplitude N/2.
+        constexpr float amplitudeScale = AudioSynthAdditive::partial_table_size / 2;
+
+        for (int t = 0; t < a.tracker.size(); t++) {
+            auto const& track = a.tracker[t];
+            if (track.age < minAge) continue;
+
+            const int bin = lroundf(track.peak.frequency / f0);
+            if (bin < 1 || bin >= AudioSynthAdditive::Partials::bins) continue;
+
+            // inharmonic partials can land on the same harmonic; keep the loudest.
+            const float amplitude = track.peak.amplitude * amplitudeScale;
+            if (amplitude > partials.amplitude[bin]) {
+                partials.set(bin, amplitude, track.peak.phase);
+            }
+        }
+    }
+
+    a.synth->partialsChanged(k);
+}
+
+bool AudioAnalyzer::step() {
+    if (!analysis) return false;
+    auto &a = *analysis;
+
+    const int nPeaks = a.stft.analyze(a.frame.data(), a.peaks.data());
+    a.tracker.update(a.peaks.data(), nPeaks);
+
+    while (a.nextOutput < AudioSynthAdditive::n_frames && a.outputHop(a.nextOutput) == a.hop) {
+        writeFrame(a.nextOutput++);
+    }
+
+    a.hop++;
+
+    const int percent = a.hop * 100 / a.totalHops;
+    if (percent / 10 != a.reportedPercent / 10) {
+        a.reportedPercent = percent;
+        Serial.print("Analyzing: ");
+        Serial.print(percent);
+        Serial.println("%");
+    }
+
+    if (a.hop >= a.totalHops || a.nextOutput >= AudioSynthAdditive::n_frames) {
+        analysis.reset();
+        return false;
+    }
+
+    // slide the frame along by a hop.
+    std::copy(a.frame.begin() + hop_size, a.frame.end(), a.frame.begin());
+    readMono(a.frame.data() + StftAnalyzer::frame_size - hop_size, hop_size);
+
     return true;
 }
 
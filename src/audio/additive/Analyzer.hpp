@@ -4,11 +4,19 @@
 #include <string>
 #include <FS.h>
 #include <memory>
+#include <Audio.h>
+#include "Stft.hpp"
 
 namespace audio {
 
 using sample = int16_t;
 
+/// @brief Mount the built-in SD card, the first time it's called.
+void initialize_sd();
+
+/// @brief Did the SD card mount?
+bool sd_ready();
+
 /**
  * Basic wave file reader for 44100/16 audio.
 */
@@ -42,21 +50,84 @@ public:
     */ 
     int length() const { return nSamples; };
 
+    /// @brief Get the number of interleaved channels.
+    int channels() const { return nChannels; }
+
     /**
-     * Read nSamples into an array of buffers.
+     * Read up to nSamples into an array of buffers, one per channel. Null buffers are skipped.
+     * Returns the number of samples actually read, which is less at the end of the file.
     */
-    void readSamples(sample **buffers, uint32_t nSamples);
+    uint32_t readSamples(sample **buffers, uint32_t nSamples);
 };
 
 
+/**
+ * Analyzes a wav file into the frames of an `AudioSynthAdditive`, a little at a time.
+ * 
+ * The file is streamed a hop at a time through a Hann-windowed STFT. Peaks are picked from each
+ * frame and tracked across frames, and evenly spaced snapshots of the tracked partials become the
+ * synth's frames, each normalized to its own fundamental.
+*/
 class AudioAnalyzer {
+public:
+    /// @brief Samples between analysis frames.
+    static constexpr int hop_size = StftAnalyzer::frame_size / 4;
+
+    /// @brief Tracks younger than this many hops are left out of the output, since they're usually noise.
+    static constexpr int min_track_age = 2;
+
 private:
     std::unique_ptr<WavReader> reader = nullptr;
 
+    /// @brief Working state, only allocated while an analysis is running.
+    struct Analysis {
+        StftAnalyzer stft {AUDIO_SAMPLE_RATE_EXACT};
+        PartialTracker tracker;
+
+        std::array<float, StftAnalyzer::frame_size> frame {};
+        std::array<SpectralPeak, StftAnalyzer::max_peaks> peaks;
+        std::array<sample, hop_size> left, right;
+
+        AudioSynthAdditive *synth;
+        float fundamental;
+
+        int hop = 0;
+        int totalHops = 0;
+        int nextOutput = 0;
+        int reportedPercent = -1;
+
+        /// @brief The hop at which to take output frame `k`.
+        int outputHop(int k) const;
+    };
+
+    std::unique_ptr<Analysis> analysis;
+
+    /// @brief Read up to `count` samples, mixed to mono, into `out`. Zero-fills past the end of the file.
+    void readMono(float *out, int count);
+
+    /// @brief Write the current tracks into output frame `k` of the synth.
+    void writeFrame(int k);
+
 public:
     bool loadFromSD(const char* path);
 
     WavReader* getReader() { return reader.get(); }
+
+    /// @brief Start analyzing the loaded file into every frame of `synth`.
+    /// @param synth the synth to fill with partials
+    /// @param fundamental the file's fundamental, in Hz, or 0 to estimate it for each frame
+    /// @return false if there's no readable file loaded.
+    bool analyze(AudioSynthAdditive &synth, float fundamental = 0);
+
+    /// @brief Analyze one hop of the file. Call this from `loop()` until it returns false.
+    /// @return true if there's more work to do.
+    bool step();
+
+    /// @brief Is an analysis running?
+    bool busy() const { return (bool) analysis; }
+
+    /// @brief How far through the file the running analysis is, 0-1.
+    float progress() const;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "Stft.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace audio {
+
+StftAnalyzer::StftAnalyzer(float sampleRate) : sampleRate(sampleRate) {
+    static_assert(frame_size == 2048, "Only the 2048-point rfft tables are pulled in.");
+    arm_rfft_fast_init_2048_f32(&fft);
+
+    for (int i = 0; i < frame_size; i++) {
+        window[i] = 0.5f - 0.5f * cosf(2 * (float) M_PI * i / frame_size);
+    }
+}
+
+int StftAnalyzer::analyze(const float *frame, SpectralPeak *peaks) {
+    constexpr int bins = frame_size / 2;
+
+    arm_mult_f32(frame, window.data(), workspace.data(), frame_size);
+    arm_rfft_fast_f32(&fft, workspace.data(), spectrum.data(), 0);
+
+    // A full-scale sinusoid peaks at N/4 through a Hann window, so this makes amplitudes 0-1.
+    constexpr float amplitudeScale = 4.f / frame_size;
+    constexpr float tiny = 1e-12f;
+
+    float loudest = logf(tiny);
+    logMagnitude[0] = logf(tiny); // we don't report DC or Nyquist
+    for (int k = 1; k < bins; k++) {
+        const float re = spectrum[k * 2], im = spectrum[k * 2 + 1];
+        logMagnitude[k] = 0.5f * logf(re * re + im * im + tiny) + logf(amplitudeScale);
+        loudest = std::max(loudest, logMagnitude[k]);
+    }
+
+    // dB to natural log magnitude.
+    constexpr float dbToLog = 0.11512925f; // ln(10) / 20
+    const float threshold = std::max(floorDb * dbToLog, loudest - rangeDb * dbToLog);
+
+    int count = 0;
+    for (int k = 2; k < bins - 1 && count < max_peaks; k++) {
+        const float a = logMagnitude[k - 1], b = logMagnitude[k], c = logMagnitude[k + 1];
+        if (b < threshold || b <= a || b < c) continue;
+
+        // fit a parabola through the log magnitudes, which is exact for a Gaussian and
+        // very close for the main lobe of a Hann window.
+        const float denominator = a - 2 * b + c;
+        const float p = denominator < 0 ? 0.5f * (a - c) / denominator : 0;
+
+        auto &peak = peaks[count++];
+        peak.frequency = (k + p) * sampleRate / frame_size;
+        peak.amplitude = expf(b - 0.25f * (a - c) * p);
+        peak.phase = atan2f(spectrum[k * 2 + 1], spectrum[k * 2]);
+    }
+
+    return count;
+}
+
+void PartialTracker::update(const SpectralPeak *peaks, int count) {
+    // Loudest peaks get first pick of the tracks, so a strong partial can't be stolen by a
+    // weak neighbor.
+    std::array<int, max_tracks> order;
+    count = std::min(count, (int) max_tracks);
+    for (int i = 0; i < count; i++) order[i] = i;
+    std::sort(order.begin(), order.begin() + count, [peaks](int x, int y) {
+        return peaks[x].amplitude > peaks[y].amplitude;
+    });
+
+    std::array<bool, max_tracks> claimed {};
+    int nNext = 0;
+
+    for (int n = 0; n < count; n++) {
+        auto const& peak = peaks[order[n]];
+
+        int best = -1;
+        float bestDistance = peak.frequency * maxDeviation;
+        for (int t = 0; t < nTracks; t++) {
+            if (claimed[t]) continue;
+
+            const float distance = fabsf(tracks[t].peak.frequency - peak.frequency);
+            if (distance <= bestDistance) {
+                best = t;
+                bestDistance = distance;
+            }
+        }
+
+        auto &next = scratch[nNext++];
+        if (best >= 0) {
+            claimed[best] = true;
+            next.id = tracks[best].id;
+            next.age = tracks[best].age + 1;
+        }
+        else {
+            next.id = nextId++;
+            next.age = 0;
+        }
+        next.peak = peak;
+    }
+
+    std::sort(scratch.begin(), scratch.begin() + nNext, [](PartialTrack const& x, PartialTrack const& y) {
+        return x.peak.frequency < y.peak.frequency;
+    });
+
+    std::swap(tracks, scratch);
+    nTracks = nNext;
+}
+
+}
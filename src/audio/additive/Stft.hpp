@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <arm_math.h>
+
+namespace audio {
+
+/// @brief A sinusoidal peak found in one STFT frame.
+struct SpectralPeak {
+    float frequency; // Hz
+    float amplitude; // linear, 1 for a full-scale sinusoid
+    float phase;     // radians, at the start of the frame
+};
+
+/// @brief Hann-windowed short-time Fourier analysis with peak picking.
+///
+/// No Arduino dependencies, just CMSIS-DSP, so the analysis can be built and checked off the device.
+class StftAnalyzer {
+public:
+    /// @brief Frame length, in samples.
+    static constexpr int frame_size = 2048;
+
+    /// @brief Most peaks reported for one frame.
+    static constexpr int max_peaks = 128;
+
+protected:
+    arm_rfft_fast_instance_f32 fft;
+
+    std::array<float, frame_size> window;
+    std::array<float, frame_size> workspace;
+    std::array<float, frame_size> spectrum;
+
+    /// @brief Natural log magnitude of each bin.
+    std::array<float, frame_size / 2> logMagnitude;
+
+    float sampleRate;
+
+public:
+    /// @brief Peaks quieter than this, relative to full scale, are ignored.
+    float floorDb = -70;
+
+    /// @brief Peaks more than this far below the loudest peak in the frame are ignored.
+    float rangeDb = 60;
+
+    explicit StftAnalyzer(float sampleRate);
+
+    /// @brief Window and transform a frame, then find its spectral peaks.
+    /// @param frame `frame_size` samples
+    /// @param peaks where to put the peaks, sorted by frequency
+    /// @return the number of peaks found, at most `max_peaks`.
+    int analyze(const float *frame, SpectralPeak *peaks);
+};
+
+/// @brief A partial followed across frames.
+struct PartialTrack {
+    int id;          // stable for the life of the track
+    int age;         // frames since the track was born
+    SpectralPeak peak;
+};
+
+/// @brief Links spectral peaks into partials from one frame to the next, by nearest frequency.
+class PartialTracker {
+public:
+    static constexpr int max_tracks = StftAnalyzer::max_peaks;
+
+protected:
+    std::array<PartialTrack, max_tracks> tracks;
+    std::array<PartialTrack, max_tracks> scratch;
+    int nTracks = 0;
+    int nextId = 0;
+
+public:
+    /// @brief A peak can continue a track if it's within this ratio of the track's frequency.
+    float maxDeviation = 0.03f;
+
+    /// @brief Match a new frame's peaks to the existing tracks. Unmatched peaks start tracks; unmatched tracks end.
+    /// @param peaks the frame's peaks
+    /// @param count number of peaks
+    void update(const SpectralPeak *peaks, int count);
+
+    /// @brief Forget every track.
+    void reset() { nTracks = 0; }
+
+    int size() const { return nTracks; }
+    PartialTrack const& operator[](int i) const { return tracks[i]; }
+};
+
+}
@@ -10,6 +10,28 @@ void VASynth::doSetup() {
 
     va_osc_mixer.gain(3, 0);
 
+    auto va = control_registry().group("va");
+    osc1.registerControls(va.group("osc1"));
+    osc2.registerControls(va.group("osc2"));
+    osc3.registerControls(va.group("osc3"));
+    va.add("osc1_type", osc1Type);
+    va.add("osc2_type", osc2Type);
+
+    auto mixer = va.group("mix");
+    mixer.add("osc12", osc12Mix);
+    mixer.add("osc1", mix.osc1);
+    mixer.add("osc2", mix.osc2);
+    mixer.add("osc3", mix.osc3);
+
+    auto filter = va.group("filter");
+    filter.add("cutoff", filterCutoffFreq);
+    filter.add("resonance", filterResonance);
+    filter.add("type", filterSwitch);
+
+    va.add("wavefold", wavefolderAmount);
+    va.add("dummy", dummyContrl);
+    va.add("amp", amplitude);
+    va.add("freq", frequency);
 }
 
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Control.hpp"
+#include "../ControlRegistry.hpp"
 #include "Arduino.h"
 #include "../audio_externs.h"
 
@@ -29,6 +30,14 @@ public:
         /// @brief Set the amplitude of the wave.
         Control<float> amplitude {"Amp.", 0.8, {0.01, 1}, [this](float a) { osc.amplitude(a); }};
 
+        void registerControls(ControlRegistry::Group const& g) {
+            g.add("type", waveType);
+            g.add("phase", phase);
+            g.add("pulse_width", pulseWidth);
+            g.add("detune", detune);
+            g.add("amp", amplitude);
+        }
+
     } osc1{va_osc1}, osc2{va_osc2};
 
 
@@ -51,27 +60,45 @@ public:
         Control<float> inLLevel {"FM.InL", 0, {0, 1}, [this](float l) { va_fm_mod_mixer.gain(2, l); }};
         Control<float> inRLevel {"FM.InR", 0, {0, 1}, [this](float l) { va_fm_mod_mixer.gain(3, l); }};
 
+        void registerControls(ControlRegistry::Group const& g) {
+            g.add("type", waveType);
+            g.add("detune", detune);
+            g.add("amp", amplitude);
+
+            auto fm = g.group("fm");
+            fm.add("osc1", osc1Level);
+            fm.add("osc2", osc2Level);
+            fm.add("in_l", inLLevel);
+            fm.add("in_r", inRLevel);
+        }
 
     } osc3{va_osc3};
 
     Control<int> osc1Type {"Type.Osc1", 0, {0, 12}, [](int choice) { va_osc1.begin(choice); }};
     Control<int> osc2Type {"Type.Osc2", 0, {0, 12}, [](int choice) { va_osc2.begin(choice); }};
 
-    /// @brief Mix between osc1 and osc2.
-    Control<float> osc12Mix {"Mix.1&2", 0, {0, 1}, [](float mix) { 
-        va_osc_mixer.gain(0, 1.f - mix);
-        va_osc_mixer.gain(1, mix);
-    }};
-
     struct OscMix {
-        Control<float> osc1 {"Mix.Osc1", 1, {0, 1}, [this](float l) { va_osc_mixer.gain(0, l); }};
-        Control<float> osc2 {"Mix.Osc2", 0, {0, 1}, [this](float l) { va_osc_mixer.gain(1, l); }};
-        Control<float> osc3 {"Mix.Osc3", 0, {0, 1}, [this](float l) { va_osc_mixer.gain(2, l); }};
+        dezip::Value osc1Gain {1, dezip::Ramp::Linear, 20, [](float l) { va_osc_mixer.gain(0, l); }};
+        dezip::Value osc2Gain {0, dezip::Ramp::Linear, 20, [](float l) { va_osc_mixer.gain(1, l); }};
+        dezip::Value osc3Gain {0, dezip::Ramp::Linear, 20, [](float l) { va_osc_mixer.gain(2, l); }};
+
+        Control<float> osc1 {"Mix.Osc1", 1, {0, 1}, [this](float l) { osc1Gain.set(l); }};
+        Control<float> osc2 {"Mix.Osc2", 0, {0, 1}, [this](float l) { osc2Gain.set(l); }};
+        Control<float> osc3 {"Mix.Osc3", 0, {0, 1}, [this](float l) { osc3Gain.set(l); }};
     } mix;
 
+    /// @brief Mix between osc1 and osc2, through the same smoothed gains as `mix`.
+    Control<float> osc12Mix {"Mix.1&2", 0, {0, 1}, [this](float l) {
+        mix.osc1Gain.set(1.f - l);
+        mix.osc2Gain.set(l);
+    }};
+
+
+    /// @brief The filter cutoff, glided so sweeps don't step.
+    dezip::Value cutoff {4000, dezip::Ramp::OnePole, 10, [](float freq) { va_filter.frequency(freq); }};
 
     /// @brief The cutoff frequency of the filter.
-    Control<float> filterCutoffFreq {"Cutoff", 4000, {20, 20000}, [](float freq) { va_filter.frequency(freq); } };
+    Control<float> filterCutoffFreq {"Cutoff", 4000, {20, 20000}, [this](float freq) { cutoff.set(freq); } };
 
     /// @brief Resonance of the filter.
     Control<float> filterResonance {"Resonance", 0.7f, {0.7f, 7.f}, [](float q) { va_filter.resonance(q); } };
@@ -113,7 +140,7 @@ public:
         va_osc3.frequency(f + *osc3.detune);
     }};
 
-    /// @brief Set up things not handled by Controls.
+    /// @brief Set up things not handled by Controls, and register the Controls under "va".
     void doSetup();
 };
 
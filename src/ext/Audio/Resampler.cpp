@@ -30,24 +30,68 @@
 #include "Resampler.h"
 #include <math.h>
 
-Resampler::Resampler(float attenuation, int32_t minHalfFilterLength, int32_t maxHalfFilterLength, StepAdaptionParameters settings): _targetAttenuation(attenuation)
-{
-	_maxHalfFilterLength=max(1, min(MAX_HALF_FILTER_LENGTH, maxHalfFilterLength));
-	_minHalfFilterLength=max(1, min(maxHalfFilterLength, minHalfFilterLength));
-#ifdef DEBUG_RESAMPLER
-	while (!Serial);
+//scratch for building a filter, shared by all tables since only one is built at a time
+DMAMEM static double kaiserWindowSamples[NO_EXACT_KAISER_SAMPLES];
+DMAMEM static double tempRes[NO_EXACT_KAISER_SAMPLES-1];
+DMAMEM static double kaiserWindowXsq[NO_EXACT_KAISER_SAMPLES-1];
+
+ResamplerFilter ResamplerFilter::_tables[MAX_FILTER_TABLES];
+
+ResamplerFilter* ResamplerFilter::acquire(const Key& key, double kaiserBeta){
+    ResamplerFilter* unused=nullptr;
+    for (ResamplerFilter& table : _tables){
+        if (table._refCount > 0 && table._key == key){
+            table._refCount++;
+            return &table;
+        }
+        if (table._refCount == 0 && !unused){
+            unused=&table;
+        }
+    }
+    if (!unused){
+        return nullptr;
+    }
+    const int32_t noSamples=key.halfFilterLength*key.overSampling+1;
+    if (noSamples > MAX_FILTER_SAMPLES){
+        return nullptr;
+    }
+#if RESAMPLER_FILTER_IN_EXTMEM
+    unused->_filter=(float*)extmem_malloc(noSamples*sizeof(float));
+#else
+    unused->_filter=(float*)malloc(noSamples*sizeof(float));
 #endif
-    _settings=settings;
+    if (!unused->_filter){
+        return nullptr;
+    }
+    unused->_key=key;
+    unused->setFilter(key.halfFilterLength, key.overSampling, key.cutOffFrequ, kaiserBeta);
+    unused->_refCount=1;
+    return unused;
+}
+
+void ResamplerFilter::release(ResamplerFilter* table){
+    if (!table || table->_refCount <= 0){
+        return;
+    }
+    if (--table->_refCount == 0){
+#if RESAMPLER_FILTER_IN_EXTMEM
+        extmem_free(table->_filter);
+#else
+        free(table->_filter);
+#endif
+        table->_filter=nullptr;
+    }
+}
+
+void ResamplerFilter::getKaiserExact(double beta){
+    const double thres=1e-10;   
     kaiserWindowSamples[0]=1.;
-    double step=1./(NO_EXACT_KAISER_SAMPLES-1);
+    double xStep=1./(NO_EXACT_KAISER_SAMPLES-1);
     double* xSq=kaiserWindowXsq;
     for (uint16_t i = 1; i <NO_EXACT_KAISER_SAMPLES; i++){
-        double x=(double)i*step;
+        double x=(double)i*xStep;
         *xSq++=(1.-x*x);
     }
-}
-void Resampler::getKaiserExact(double beta){
-    const double thres=1e-10;   
     double* winS=&kaiserWindowSamples[1];
     double* t=tempRes;
     for (uint16_t i = 1; i <NO_EXACT_KAISER_SAMPLES; i++){
@@ -86,11 +130,11 @@ void Resampler::getKaiserExact(double beta){
     }
 }
     
-void Resampler::setKaiserWindow(double beta, int32_t noSamples){
+void ResamplerFilter::setKaiserWindow(double beta, int32_t noSamples){
     getKaiserExact(beta);
     double step=(double)(NO_EXACT_KAISER_SAMPLES-1)/(double)(noSamples-1);
     double xPos=step;
-    float* filterCoeff=filter;
+    float* filterCoeff=_filter;
     *filterCoeff=1.;
     ++filterCoeff;
     int32_t lower=(int)(xPos);
@@ -113,12 +157,12 @@ void Resampler::setKaiserWindow(double beta, int32_t noSamples){
     *filterCoeff=*windowUpper;
 }
 
-void Resampler::setFilter(int32_t halfFiltLength,int32_t overSampling, double cutOffFrequ, double kaiserBeta){
+void ResamplerFilter::setFilter(int32_t halfFiltLength,int32_t overSampling, double cutOffFrequ, double kaiserBeta){
 
     const int32_t noSamples=halfFiltLength*overSampling+1;
     setKaiserWindow(kaiserBeta, noSamples);  
     
-    float* filterCoeff=filter;
+    float* filterCoeff=_filter;
     *filterCoeff++=(float)cutOffFrequ;
     double step=halfFiltLength/(noSamples-1.);
     double xPos=step;
@@ -129,6 +173,20 @@ void Resampler::setFilter(int32_t halfFiltLength,int32_t overSampling, double cu
     } 
 }
 
+Resampler::Resampler(float attenuation, int32_t minHalfFilterLength, int32_t maxHalfFilterLength, StepAdaptionParameters settings): _targetAttenuation(attenuation)
+{
+	_maxHalfFilterLength=max(1, min(MAX_HALF_FILTER_LENGTH, maxHalfFilterLength));
+	_minHalfFilterLength=max(1, min(maxHalfFilterLength, minHalfFilterLength));
+#ifdef DEBUG_RESAMPLER
+	while (!Serial);
+#endif
+    _settings=settings;
+}
+
+Resampler::~Resampler(){
+    ResamplerFilter::release(_filterTable);
+}
+
 double Resampler::getStep() const {
     return  _stepAdapted;
 }
@@ -141,33 +199,28 @@ int32_t Resampler::getHalfFilterLength() const{
 void Resampler::reset(){
     _initialized=false;
 }
-void Resampler::configure(float fs, float newFs){
+bool Resampler::configure(float fs, float newFs){
     // Serial.print("configure, fs: ");
     // Serial.println(fs);
     if (fs<=0.f || newFs <=0.f){
 		_attenuation=0.;
 		_halfFilterLength=0;
         _initialized=false;
-        return;
-    }
-	_attenuation=_targetAttenuation;
-    _step=(double)fs/(double)newFs;
-    _configuredStep=_step;
-    _stepAdapted=_step;
-    _sum=0.;
-    _oldDiffs[0]=0.;
-    _oldDiffs[1]=0.;
-    for (uint8_t i =0; i< MAX_NO_CHANNELS; i++){
-        memset(_buffer[i], 0, sizeof(float)*_maxHalfFilterLength*2);
+        ResamplerFilter::release(_filterTable);
+        _filterTable=nullptr;
+        filter=nullptr;
+        return false;
     }
-
+    //work the filter out in locals, so nothing changes unless there's a table for it
+	double attenuation=_targetAttenuation;
     double kaiserBeta, cutOffFrequ;
-    _overSamplingFactor=1024;
+    int32_t halfFilterLength;
+    int32_t overSamplingFactor=1024;
     if (fs <= newFs){
-		_attenuation=0;
+		attenuation=0;
         cutOffFrequ=1.;
         kaiserBeta=10.;
-        _halfFilterLength=_minHalfFilterLength;
+        halfFilterLength=_minHalfFilterLength;
     }
     else{
         cutOffFrequ=newFs/fs;
@@ -176,31 +229,31 @@ void Resampler::configure(float fs, float newFs){
         Serial.print("b: ");
         Serial.println(b);
 #endif
-        int32_t hfl=(int32_t)((_attenuation-8.)/(2.*2.285*TWO_PI*b)+0.5);
+        int32_t hfl=(int32_t)((attenuation-8.)/(2.*2.285*TWO_PI*b)+0.5);
         if (hfl >= _minHalfFilterLength && hfl <= _maxHalfFilterLength){
-            _halfFilterLength=hfl;
+            halfFilterLength=hfl;
         }
         else if (hfl < _minHalfFilterLength){
-            _halfFilterLength=_minHalfFilterLength;
-            _attenuation=((2.*(double)_halfFilterLength+1.)-1.)*(2.285*TWO_PI*b)+8.;            
+            halfFilterLength=_minHalfFilterLength;
+            attenuation=((2.*(double)halfFilterLength+1.)-1.)*(2.285*TWO_PI*b)+8.;            
         }
         else{
-            _halfFilterLength=_maxHalfFilterLength;
-            _attenuation=((2.*(double)_halfFilterLength+1.)-1.)*(2.285*TWO_PI*b)+8.;
+            halfFilterLength=_maxHalfFilterLength;
+            attenuation=((2.*(double)halfFilterLength+1.)-1.)*(2.285*TWO_PI*b)+8.;
         }
-        if (_attenuation>50.){
-            kaiserBeta=0.1102*(_attenuation-8.7);
+        if (attenuation>50.){
+            kaiserBeta=0.1102*(attenuation-8.7);
         }
-        else if (21.<=_attenuation && _attenuation<=50.){
-            kaiserBeta=0.5842*pow(_attenuation-21.,0.4)+0.07886*(_attenuation-21.);
+        else if (21.<=attenuation && attenuation<=50.){
+            kaiserBeta=0.5842*pow(attenuation-21.,0.4)+0.07886*(attenuation-21.);
         }
         else{
             kaiserBeta=0.;
         }
-        int32_t noSamples=_halfFilterLength*_overSamplingFactor+1;
+        int32_t noSamples=halfFilterLength*overSamplingFactor+1;
         if (noSamples > MAX_FILTER_SAMPLES){
             int32_t f = (noSamples-1)/(MAX_FILTER_SAMPLES-1)+1;
-            _overSamplingFactor/=f;
+            overSamplingFactor/=f;
         }
     }
 
@@ -210,30 +263,67 @@ void Resampler::configure(float fs, float newFs){
     Serial.print("cutOffFrequ: ");
     Serial.println(cutOffFrequ);
     Serial.print("filter length: ");
-    Serial.println(2*_halfFilterLength+1);
+    Serial.println(2*halfFilterLength+1);
     Serial.print("overSampling: ");
-    Serial.println(_overSamplingFactor);
+    Serial.println(overSamplingFactor);
     Serial.print("kaiserBeta: ");
     Serial.println(kaiserBeta, 12);
     Serial.print("_step: ");
-    Serial.println(_step, 12);
+    Serial.println((double)fs/(double)newFs, 12);
 #endif
-    setFilter(_halfFilterLength, _overSamplingFactor, cutOffFrequ, kaiserBeta);
+    //take the new table before letting go of the old one, so reconfiguring with the same settings doesn't rebuild it
+    ResamplerFilter* table=ResamplerFilter::acquire({attenuation, cutOffFrequ, halfFilterLength, overSamplingFactor}, kaiserBeta);
+    if (!table){
+        //no free slot or memory: the old filter and position stay as they were, so resample() still
+        //reads a valid table, but callers checking initialized() see that the new rate didn't take
+        _initialized=false;
+        return false;
+    }
+    ResamplerFilter::release(_filterTable);
+    _filterTable=table;
+    filter=table->coefficients();
+
+	_attenuation=attenuation;
+    _halfFilterLength=halfFilterLength;
+    _overSamplingFactor=overSamplingFactor;
+    _step=(double)fs/(double)newFs;
+    _configuredStep=_step;
+    _stepAdapted=_step;
+    _sum=0.;
+    _oldDiffs[0]=0.;
+    _oldDiffs[1]=0.;
+    for (uint8_t i =0; i< MAX_NO_CHANNELS; i++){
+        memset(_buffer[i], 0, sizeof(float)*_maxHalfFilterLength*2);
+    }
     _filterLength=_halfFilterLength*2;
     for (uint8_t i =0; i< MAX_NO_CHANNELS; i++){
         _endOfBuffer[i]=&_buffer[i][_filterLength];
     }
     _cPos=-_halfFilterLength;   //marks the current center position of the filter
     _initialized=true;
+    return true;
 }
 bool Resampler::initialized() const {
     return _initialized;
 }
 
 void Resampler::resample(float* input0, float* input1, uint16_t inputLength, uint16_t& processedLength, float* output0, float* output1,uint16_t outputLength, uint16_t& outputCount) {
+    if (!filter){
+        //never configured, or configured with an invalid rate: drop the input rather than read a missing table
+        outputCount=0;
+        processedLength=inputLength;
+        return;
+    }
+    if (_fixedPoint){
+        float* inputs[2]={input0, input1};
+        float* outputs[2]={output0, output1};
+        resampleFixed<2>(inputs, inputLength, processedLength, outputs, outputLength, outputCount);
+        return;
+    }
     outputCount=0;
     int32_t successorIndex=(int32_t)(ceil(_cPos));  //negative number -> currently the _buffer0 of the last iteration is used
-    float* ip0, *ip1, *fPtr;
+    float* ip0, *ip1;
+    const float* fPtr;
     float filterC;
     float si0[2];
     float si1[2];
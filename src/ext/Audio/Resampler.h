@@ -38,6 +38,47 @@
 #define NO_EXACT_KAISER_SAMPLES 1025
 #define MAX_HALF_FILTER_LENGTH 80
 #define MAX_NO_CHANNELS 8
+
+#ifndef MAX_FILTER_TABLES
+#define MAX_FILTER_TABLES 2 //number of differently configured filters that can exist at once
+#endif
+
+#ifndef RESAMPLER_FILTER_IN_EXTMEM
+#define RESAMPLER_FILTER_IN_EXTMEM 0 //put filter coefficients in PSRAM (falls back to the heap if there's none)
+#endif
+
+//Anti-aliasing filter coefficients, shared by every Resampler configured the same way.
+//Tables are built on first use, reference counted, and freed when the last Resampler lets go.
+class ResamplerFilter {
+    public:
+        struct Key {
+            double attenuation;
+            double cutOffFrequ;
+            int32_t halfFilterLength;
+            int32_t overSampling;
+            bool operator==(const Key& other) const {
+                return attenuation==other.attenuation && cutOffFrequ==other.cutOffFrequ
+                    && halfFilterLength==other.halfFilterLength && overSampling==other.overSampling;
+            }
+        };
+        ///@param key the filter settings. The cut-off frequency is part of the key, since it shapes the coefficients as much as the rest
+        ///@param kaiserBeta Kaiser window parameter, derived from the attenuation
+        ///@return a table for these settings, built if no Resampler is already using one, or nullptr if there's no free slot or memory
+        static ResamplerFilter* acquire(const Key& key, double kaiserBeta);
+        ///@param table a table from acquire(), or nullptr
+        static void release(ResamplerFilter* table);
+        const float* coefficients() const { return _filter; }
+        const Key& key() const { return _key; }
+    private:
+        static void getKaiserExact(double beta);
+        void setKaiserWindow(double beta, int32_t noSamples);
+        void setFilter(int32_t halfFiltLength,int32_t overSampling, double cutOffFrequ, double kaiserBeta);
+        Key _key;
+        float* _filter=nullptr;
+        int32_t _refCount=0;
+        static ResamplerFilter _tables[MAX_FILTER_TABLES];
+};
+
 class Resampler {
     public:
 
@@ -50,10 +91,14 @@ class Resampler {
             double kd= 1.8;
         };
         Resampler(float attenuation=100, int32_t minHalfFilterLength=20, int32_t maxHalfFilterLength=80, StepAdaptionParameters settings=StepAdaptionParameters());
+        ~Resampler();
+        Resampler(const Resampler&) = delete;
+        Resampler& operator=(const Resampler&) = delete;
         void reset();
         ///@param attenuation target attenuation [dB] of the anti-aliasing filter. Only used if newFs<fs. The attenuation can't be reached if the needed filter length exceeds 2*MAX_FILTER_SAMPLES+1
         ///@param minHalfFilterLength If newFs >= fs, the filter length of the resampling filter is 2*minHalfFilterLength+1. If fs y newFs the filter is maybe longer to reach the desired attenuation
-        void configure(float fs, float newFs);
+        ///@return false if the rates are invalid, or there's no free filter table or memory for them. Without a table the previous configuration is kept, but initialized() turns false
+        bool configure(float fs, float newFs);
         ///@param input0 first input array/ channel
         ///@param input1 second input array/ channel
         ///@param inputLength length of each input array
@@ -75,21 +120,102 @@ class Resampler {
         //resampling NOCHANNELS channels. Performance is increased a lot if the number of channels is known at compile time -> the number of channels is a template argument
         template <uint8_t NOCHANNELS>
         inline void resample(float** inputs, uint16_t inputLength, uint16_t& processedLength, float** outputs, uint16_t outputLength, uint16_t& outputCount){
+            resampleAt<NOCHANNELS, DoublePosition>(inputs, inputLength, processedLength, outputs, outputLength, outputCount);
+        }
+
+        //Same as resample<NOCHANNELS>, but tracks the position in 32.32 fixed point and keeps the inner loop
+        //in integer and float arithmetic, with no double ceil/floor per output sample. The position and
+        //adapted step are converted once per call, so getXPos(), addToPos() and the step adaption work unchanged.
+        //Uses the same filter table, so the attenuation is the same; the interpolation weights differ by float rounding.
+        template <uint8_t NOCHANNELS>
+        inline void resampleFixed(float** inputs, uint16_t inputLength, uint16_t& processedLength, float** outputs, uint16_t outputLength, uint16_t& outputCount){
+            resampleAt<NOCHANNELS, FixedPosition>(inputs, inputLength, processedLength, outputs, outputLength, outputCount);
+        }
+        //use resampleFixed<2> for the two channel resample()
+        void fixedPointPosition(bool enable) { _fixedPoint=enable; }
+    private:
+        //The filter position for resampleAt(), kept as a double, the way the original loop did.
+        struct DoublePosition {
+            double pos;
+            double step;
+            int32_t successor;  //ceil(pos), stepped along with it rather than recomputed
+            DoublePosition(double cPos, double stepAdapted) : pos(cPos), step(stepAdapted), successor((int32_t)(ceil(cPos))) {}
+            //the last input sample the filter reaches
+            int32_t last(int32_t halfLength) const { return (int32_t)floor(pos + halfLength); }
+            //the first input sample after the position. Negative -> in the history of the last call
+            int32_t next() const { return successor; }
+            ///@return the ceiling of the position's scaled distance to next(), the filter table index to start from
+            ///@param w0 set to the weight of the left neighbour in the filter table
+            int32_t phase(int32_t overSampling, float& w0) const {
+                const float dist=successor-pos;
+                const float distScaled=dist*overSampling;
+                w0=ceilf(distScaled)-distScaled;
+                return (int32_t)(ceilf(distScaled));
+            }
+            void advance(){
+                pos+=step;
+                while (pos >successor){
+                    successor++;
+                }
+            }
+            ///@return the position for the next call, once the processed samples are gone
+            double rewind(uint16_t processedLength, int32_t halfLength){
+                pos-=processedLength;
+                return pos < -halfLength ? -halfLength : pos;
+            }
+        };
+
+        //The filter position for resampleAt() in 32.32 fixed point.
+        struct FixedPosition {
+            static constexpr double one=4294967296.;
+            int64_t pos;
+            int64_t step;
+            FixedPosition(double cPos, double stepAdapted) : pos((int64_t)llround(cPos*one)), step((int64_t)llround(stepAdapted*one)) {}
+            int32_t last(int32_t halfLength) const { return (int32_t)(pos >> 32) + halfLength; }
+            int32_t next() const { return (int32_t)((pos + 0xFFFFFFFFll) >> 32); }  //ceil
+            int32_t phase(int32_t overSampling, float& w0) const {
+                const uint32_t dist=(uint32_t)(((int64_t)next() << 32) - pos);  //next() - position, 0.32
+                const uint64_t distScaled=(uint64_t)dist*overSampling;          //32.32
+                const int32_t distCeil=(int32_t)((distScaled + 0xFFFFFFFFull) >> 32);
+                w0=(float)(uint32_t)(((uint64_t)distCeil << 32) - distScaled)*(1.f/4294967296.f);
+                return distCeil;
+            }
+            void advance(){ pos+=step; }
+            double rewind(uint16_t processedLength, int32_t halfLength){
+                pos-=(int64_t)processedLength << 32;
+                if (pos < -((int64_t)halfLength << 32)){
+                    pos=-((int64_t)halfLength << 32);
+                }
+                return (double)pos/one;
+            }
+        };
+
+        //the loop behind resample<NOCHANNELS> and resampleFixed<NOCHANNELS>; Position is how the filter position is tracked
+        template <uint8_t NOCHANNELS, typename Position>
+        inline void resampleAt(float** inputs, uint16_t inputLength, uint16_t& processedLength, float** outputs, uint16_t outputLength, uint16_t& outputCount){
+            if (!filter){
+                outputCount=0;
+                processedLength=inputLength;
+                return;
+            }
+            Position position(_cPos, _stepAdapted);
+            const int32_t halfLength=_halfFilterLength;
+            const int32_t overSampling=_overSamplingFactor;
+
             outputCount=0;
-            int32_t successorIndex=(int32_t)(ceil(_cPos));  //negative number -> currently the _buffer0 of the last iteration is used
             float* ip[NOCHANNELS];
-            float* fPtr;
+            const float* fPtr;
         
             float si0[NOCHANNELS];
             float* si0Ptr;
             float si1[NOCHANNELS];
             float* si1Ptr;
-            while (floor(_cPos + _halfFilterLength) < inputLength && outputCount < outputLength){
-                float dist=successorIndex-_cPos;
-                    
-                float distScaled=dist*_overSamplingFactor;
-                int32_t rightIndex=abs((int32_t)(ceilf(distScaled))-_overSamplingFactor*_halfFilterLength);   
-                const int32_t indexData=successorIndex-_halfFilterLength;
+            while (position.last(halfLength) < inputLength && outputCount < outputLength){
+                const int32_t successorIndex=position.next();
+                float w0;
+                const int32_t distCeil=position.phase(overSampling, w0);
+                int32_t rightIndex=abs(distCeil-overSampling*halfLength);   
+                const int32_t indexData=successorIndex-halfLength;
                 if (indexData>=0){
                     for (uint8_t i =0; i< NOCHANNELS; i++){
                         ip[i]=inputs[i]+indexData;
@@ -102,19 +228,19 @@ class Resampler {
                 }       
                 fPtr=filter+rightIndex;
                 memset(si0, 0, NOCHANNELS*sizeof(float));
-                if (rightIndex==_overSamplingFactor*_halfFilterLength){
+                if (rightIndex==overSampling*halfLength){
                     si1Ptr=si1;
                     for (uint8_t i=0; i< NOCHANNELS; i++){
                         *(si1Ptr++)=*ip[i]++**fPtr;
                     }
-                    fPtr-=_overSamplingFactor;          
-                    rightIndex=(int32_t)(ceilf(distScaled))+_overSamplingFactor;     //needed below  
+                    fPtr-=overSampling;          
+                    rightIndex=distCeil+overSampling;     //needed below  
                 }
                 else {
                     memset(si1, 0, NOCHANNELS*sizeof(float));
-                    rightIndex=(int32_t)(ceilf(distScaled));     //needed below
+                    rightIndex=distCeil;     //needed below
                 }
-                for (uint16_t i =0 ; i<_halfFilterLength; i++){
+                for (int32_t i =0 ; i<halfLength; i++){
                     if(ip[0]==_endOfBuffer[0]){
                         for (uint8_t i =0; i< NOCHANNELS; i++){
                             ip[i]=inputs[i];
@@ -128,10 +254,10 @@ class Resampler {
                         *(si1Ptr++)+=*ip[i]**fPtr; 
                         ++ip[i];
                     }       
-                    fPtr-=_overSamplingFactor; 
+                    fPtr-=overSampling; 
                 }
                 fPtr=filter+rightIndex-1;
-                for (uint16_t i =0 ; i<_halfFilterLength; i++){  
+                for (int32_t i =0 ; i<halfLength; i++){  
                     if(ip[0]==_endOfBuffer[0]){
                         for (uint8_t i =0; i< NOCHANNELS; i++){
                             ip[i]=inputs[i];
@@ -145,9 +271,8 @@ class Resampler {
                         *(si1Ptr++)+=*ip[i]*fPtrSucc;  
                         ++ip[i];
                     }
-                    fPtr+=_overSamplingFactor;
+                    fPtr+=overSampling;
                 }
-                const float w0=ceilf(distScaled)-distScaled;
                 const float w1=1.0f-w0;
                 si0Ptr=si0;
                 si1Ptr=si1;
@@ -155,19 +280,22 @@ class Resampler {
                     *outputs[i]++=*(si0Ptr++)*w0 + *(si1Ptr++)*w1;
                 }
                 outputCount++;
-                _cPos+=_stepAdapted;
-                while (_cPos >successorIndex){
-                    successorIndex++;
-                }
+                position.advance();
             }
             if(outputCount < outputLength){
                 //ouput vector not full -> we ran out of input samples
                 processedLength=inputLength;
             }
             else{
-                processedLength=min(inputLength, (int16_t)floor(_cPos + _halfFilterLength));
+                processedLength=min((int32_t)inputLength, position.last(halfLength));
             }
-            //fill _buffer
+            storeHistory<NOCHANNELS>(inputs, processedLength);
+            _cPos=position.rewind(processedLength, halfLength);
+        }
+
+        //keep the last _filterLength input samples of each channel for the next call
+        template <uint8_t NOCHANNELS>
+        inline void storeHistory(float** inputs, uint16_t processedLength){
             const int32_t indexData=processedLength-_filterLength;
             if (indexData>=0){
                 const unsigned long long bytesToCopy= _filterLength*sizeof(float);
@@ -191,19 +319,10 @@ class Resampler {
                     ++inPtr;
                 }
             }
-            _cPos-=processedLength;
-            if (_cPos < -_halfFilterLength){
-                _cPos=-_halfFilterLength;
-            }
         }
-    private:
-        void getKaiserExact(double beta);
-        void setKaiserWindow(double beta, int32_t noSamples);
-        void setFilter(int32_t halfFiltLength,int32_t overSampling, double cutOffFrequ, double kaiserBeta);
-        float filter[MAX_FILTER_SAMPLES];
-        double kaiserWindowSamples[NO_EXACT_KAISER_SAMPLES];
-        double tempRes[NO_EXACT_KAISER_SAMPLES-1];
-        double kaiserWindowXsq[NO_EXACT_KAISER_SAMPLES-1];
+        bool _fixedPoint=false;
+        ResamplerFilter* _filterTable=nullptr;
+        const float* filter=nullptr;    //_filterTable's coefficients
         float _buffer[MAX_NO_CHANNELS][MAX_HALF_FILTER_LENGTH*2];
         float* _endOfBuffer[MAX_NO_CHANNELS];
 
@@ -0,0 +1,105 @@
+#include "dezipper.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace dezip {
+
+/// @brief Values still ramping. Only touched from the audio interrupt.
+static Value *firstActive = nullptr;
+
+Value::Value(float initial, Ramp shape, float rampMs, apply_function apply) : current(initial), _target(initial), shape(shape), apply(apply) {
+    time(rampMs);
+}
+
+void Value::time(float ms) {
+    rampMs = std::max(0.f, ms);
+
+    const float samples = rampMs * (AUDIO_SAMPLE_RATE_EXACT / 1000.f);
+    decaySample = samples > 0 ? expf(-1.f / samples) : 0;
+    decayBlock = powf(decaySample, AUDIO_BLOCK_SAMPLES);
+}
+
+void Value::set(float target) {
+    _target = target;
+    arrived = false;
+
+    if (shape == Ramp::Linear) {
+        remaining = (target == current) ? 0 : std::max(1, (int) (rampMs * (AUDIO_SAMPLE_RATE_EXACT / 1000.f)));
+        step = remaining ? (target - current) / remaining : 0;
+    }
+
+    if (!active) {
+        active = true;
+        nextActive = firstActive;
+        firstActive = this;
+    }
+}
+
+void Value::jump(float target) {
+    current = target;
+    set(target);
+}
+
+bool Value::settled() const {
+    // -80 dB of a gain, or a fraction of a Hz of a frequency.
+    return fabsf(_target - current) <= 1e-4f * std::max(1.f, fabsf(_target));
+}
+
+bool Value::advance() {
+    if (shape == Ramp::Linear) {
+        const int n = std::min(remaining, AUDIO_BLOCK_SAMPLES);
+        current += step * n;
+        remaining -= n;
+        if (remaining > 0) return false;
+    }
+    else {
+        current = _target + (current - _target) * decayBlock;
+        if (!settled()) return false;
+    }
+
+    current = _target;
+    return true;
+}
+
+bool SampleValue::advance() {
+    if (shape == Ramp::Linear) {
+        const int n = std::min(remaining, AUDIO_BLOCK_SAMPLES);
+        for (int i = 0; i < n; i++) {
+            current += step;
+            ramp[i] = current;
+        }
+        remaining -= n;
+        if (remaining > 0) return false;
+
+        current = _target;
+        std::fill(ramp.begin() + std::max(0, n - 1), ramp.end(), current);
+        return true;
+    }
+
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        current = _target + (current - _target) * decaySample;
+        ramp[i] = current;
+    }
+    if (!settled()) return false;
+
+    current = _target;
+    ramp.back() = current;
+    return true;
+}
+
+void advance_all() {
+    Value **link = &firstActive;
+    while (Value *value = *link) {
+        if (value->arrived) {
+            value->active = false;
+            *link = value->nextActive;
+            continue;
+        }
+
+        value->arrived = value->advance();
+        if (value->apply) value->apply(value->current);
+        link = &value->nextActive;
+    }
+}
+
+}
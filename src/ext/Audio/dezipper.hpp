@@ -1,17 +1,104 @@
 #pragma once
 
-#include <optional>
+#include <AudioStream.h>
+#include <array>
 
+/// Parameter smoothing, so stepping a control doesn't zipper.
+///
+/// A `Value` glides towards whatever it was last `set()` to, and hands each new value to its apply
+/// function. Everything ramping is advanced together by `advance_all()`, once at the start of each
+/// block; values that have arrived drop out of that pass, so they cost nothing. All of it runs in
+/// the audio interrupt: call `set()` from a Control's update function.
 namespace dezip {
 
-template <typename T>
+/// @brief How a value approaches its target.
+enum class Ramp {
+    Linear,  // straight line, arriving after the ramp time
+    OnePole, // exponential, covering 63% of the way in the ramp time
+};
+
+/// @brief A parameter smoothed once per block: the apply function sees one value per block.
 class Value {
-    T *value;
-    std::optional<T> target;
+public:
+    /// @brief Called with the smoothed value, once per block while ramping.
+    using apply_function = void (*)(float);
+
+protected:
+    float current;
+    float _target;
+
+    Ramp shape;
+    float rampMs;
+
+    /// @brief Linear: change per sample, and samples until we're there.
+    float step = 0;
+    int remaining = 0;
+
+    /// @brief One-pole: how much of the distance is left after a sample, and after a block.
+    float decaySample = 0, decayBlock = 0;
+
+    apply_function apply;
+
+    /// @brief Intrusive list of ramping values, and whether we're on it.
+    Value *nextActive = nullptr;
+    bool active = false;
+
+    /// @brief Got to the target last block. We stay listed for that block, so per-sample readers
+    /// see the end of the ramp, and drop out on the next pass.
+    bool arrived = false;
+
+    friend void advance_all();
+
+    /// @brief Move one block towards the target.
+    /// @return true once it's arrived
+    virtual bool advance();
+
+    /// @brief Is a one-pole ramp close enough to snap to the target?
+    bool settled() const;
 
-    Value(T & v) : value(&v), target() {}
+public:
+    /// @param initial the starting value, which isn't applied until the first `set()`
+    /// @param shape how to approach a new target
+    /// @param rampMs ramp time in ms, see `Ramp`
+    /// @param apply gets the smoothed value, can be null for values that are read instead
+    Value(float initial, Ramp shape, float rampMs, apply_function apply = nullptr);
 
-    
+    virtual ~Value() {}
+
+    /// @brief Glide to a new value. Applies it at the next block even if it's the current one.
+    void set(float target);
+
+    /// @brief Go straight to a new value at the next block, without a ramp.
+    void jump(float target);
+
+    /// @brief Change the ramp time, for the next `set()`.
+    void time(float ms);
+
+    /// @brief Current smoothed value, as of the end of this block.
+    float get() const { return current; }
+
+    float target() const { return _target; }
+
+    /// @brief Still on its way to the target?
+    bool ramping() const { return active; }
 };
 
-}
\ No newline at end of file
+/// @brief A parameter smoothed every sample, for audio objects that can take a value per sample.
+/// The apply function, if any, still sees the value at the end of each block.
+class SampleValue : public Value {
+    std::array<float, AUDIO_BLOCK_SAMPLES> ramp;
+
+protected:
+    virtual bool advance() override;
+
+public:
+    using Value::Value;
+
+    /// @brief This block's value for each sample. Only filled while `ramping()`; otherwise use `get()`.
+    const float *samples() const { return ramp.data(); }
+};
+
+/// @brief Advance every ramping value by one block and apply it. Call at the start of each block.
+void advance_all();
+
+}
@@ -0,0 +1,97 @@
+#ifndef event_pool_h_
+#define event_pool_h_
+
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#include "timer-wheel.h"
+
+/// @brief A fixed set of preallocated timer events, handed out from an intrusive free list.
+///
+/// `acquire()` and `release()` are O(1) and never touch the heap, so audio objects can schedule
+/// `TimerWheel` events from inside `update()`. Free slots hold the list link in their own storage,
+/// so the pool costs nothing beyond `Capacity` events and a few counters.
+///
+/// There's no locking. Use a pool from one context only (normally the audio interrupt), or
+/// wrap calls from other contexts in `__disable_irq()`/`__enable_irq()`.
+/// @tparam Event a `TimerEventInterface` subclass
+/// @tparam Capacity the most events that can be out at once
+template <typename Event, int Capacity>
+class EventPool {
+    static_assert(Capacity > 0, "Pool needs at least one event.");
+
+    /// @brief Storage for one event, which doubles as a free list node while unused.
+    union Slot {
+        Slot *nextFree;
+        alignas(Event) unsigned char storage[sizeof(Event)];
+
+        Slot() : nextFree(nullptr) {}
+    };
+
+    Slot slots[Capacity];
+    Slot *freeList = nullptr;
+
+    int outstanding = 0;
+    int highWater = 0;
+    uint32_t exhaustions = 0;
+
+public:
+    static constexpr int capacity = Capacity;
+
+    EventPool() {
+        for (int i = Capacity - 1; i >= 0; i--) {
+            slots[i].nextFree = freeList;
+            freeList = &slots[i];
+        }
+    }
+
+    ~EventPool() = default;
+
+    EventPool(EventPool const&) = delete;
+    EventPool& operator=(EventPool const&) = delete;
+
+    /// @brief Construct an event in a free slot.
+    /// @param args passed to the event's constructor
+    /// @return the new event, or null if the pool is exhausted.
+    template <typename... Args>
+    Event* acquire(Args&&... args) {
+        if (!freeList) {
+            exhaustions++;
+            return nullptr;
+        }
+
+        Slot *slot = freeList;
+        freeList = slot->nextFree;
+
+        if (++outstanding > highWater) highWater = outstanding;
+
+        return new (slot->storage) Event(std::forward<Args>(args)...);
+    }
+
+    /// @brief Destroy an event and return its slot to the pool. The event is canceled if it's scheduled.
+    ///
+    /// Safe to call from the event's own `execute()`, as long as it touches nothing afterward.
+    void release(Event *event) {
+        if (!event) return;
+
+        event->~Event();
+
+        // union members all start at the slot's address.
+        Slot *slot = reinterpret_cast<Slot*>(event);
+        slot->nextFree = freeList;
+        freeList = slot;
+        outstanding--;
+    }
+
+    /// @brief Number of events currently acquired.
+    int inUse() const { return outstanding; }
+
+    /// @brief The most events that have ever been acquired at once.
+    int peakUse() const { return highWater; }
+
+    /// @brief Number of times `acquire()` has failed for lack of a free slot.
+    uint32_t exhausted() const { return exhaustions; }
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef polyphase_h_
+#define polyphase_h_
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace resample {
+
+/// @brief A precomputed bank of Blackman-windowed sinc interpolation filters.
+///
+/// Row `p` holds the `Taps` coefficients for reading a signal at a fractional offset of
+/// `p / Phases` past an integer sample, so interpolating costs `Taps` multiply-adds and no trig.
+/// There's no anti-aliasing here: the input must already be band-limited for the playback rate
+/// (see the mip levels in `AudioSynthAdditive`).
+/// @tparam Phases number of fractional positions, a power of two
+/// @tparam Taps filter length, even
+template <int Phases, int Taps>
+class PolyphaseBank {
+    static_assert((Phases & (Phases - 1)) == 0, "Phase count must be a power of two.");
+    static_assert(Taps > 0 && (Taps % 2) == 0, "Tap count must be even.");
+
+public:
+    static constexpr int phases = Phases;
+    static constexpr int taps = Taps;
+
+    /// @brief log2(Phases), how many fraction bits select a phase.
+    static constexpr int phase_bits = [] {
+        int bits = 0;
+        while ((1 << bits) < Phases) bits++;
+        return bits;
+    }();
+
+    /// @brief Offset from the integer sample to the first tap.
+    static constexpr int first_tap = 1 - (Taps / 2);
+
+private:
+    std::array<float, Phases * Taps> coefficients;
+
+public:
+    PolyphaseBank() {
+        constexpr double pi = 3.14159265358979323846;
+        constexpr double halfSpan = Taps / 2.0;
+
+        for (int p = 0; p < Phases; p++) {
+            const double frac = (double) p / Phases;
+            double sum = 0;
+
+            for (int t = 0; t < Taps; t++) {
+                const double x = (first_tap + t) - frac; // distance from the read position
+                const double sinc = (std::abs(x) < 1e-9) ? 1.0 : std::sin(pi * x) / (pi * x);
+
+                // Blackman, centered on the read position and spanning all the taps.
+                const double m = (x + halfSpan) / (2 * halfSpan);
+                const double window = 0.42 - 0.5 * std::cos(2 * pi * m) + 0.08 * std::cos(4 * pi * m);
+
+                coefficients[p * Taps + t] = sinc * window;
+                sum += sinc * window;
+            }
+
+            // unity gain at DC for every phase, so there's no phase-dependent ripple.
+            for (int t = 0; t < Taps; t++) {
+                coefficients[p * Taps + t] /= sum;
+            }
+        }
+    }
+
+    /// @brief Get the coefficient row for a phase.
+    const float *row(int phase) const { return &coefficients[phase * Taps]; }
+
+    /// @brief Interpolate a looped, power-of-two length table.
+    /// @param table the table to read
+    /// @param mask table length - 1
+    /// @param index the integer sample position
+    /// @param phase the fractional position, in [0, Phases)
+    inline float read(const float *table, int mask, int index, int phase) const {
+        const float *h = row(phase);
+        const int first = index + first_tap;
+
+        float accum = 0;
+        for (int t = 0; t < Taps; t++) {
+            accum += h[t] * table[(first + t) & mask];
+        }
+        return accum;
+    }
+
+    /// @brief Interpolate a looped table using a 32-bit phase accumulator covering one full cycle.
+    /// @param table the table to read
+    /// @param sizeBits log2 of the table length
+    /// @param cyclePhase the playback position, 0 to 2^32 for one pass through the table
+    inline float read_cycle(const float *table, int sizeBits, uint32_t cyclePhase) const {
+        const int index = cyclePhase >> (32 - sizeBits);
+        const int phase = (cyclePhase >> (32 - sizeBits - phase_bits)) & (Phases - 1);
+        return read(table, (1 << sizeBits) - 1, index, phase);
+    }
+};
+
+} // namespace resample
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef resample_quality_h_
+#define resample_quality_h_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+/// A common yardstick for the different ways this tree reads a sample at a fractional position.
+///
+/// Every method is driven through the same interface:
+///
+///     void render(const float *table, int sizeBits, double ratio, float *out, int count);
+///
+/// which fills `out` with `count` samples read from the looped, power-of-two length `table`,
+/// starting at position zero and advancing `ratio` input samples per output sample (so a ratio
+/// of 2 plays an octave up). `resample_quality()` plays test tones through a method, and
+/// `format_resample_report()` writes a result as one JSON line. Nothing here depends on Arduino,
+/// so methods can be measured off the device too.
+namespace resample {
+
+/// @brief How a method behaves at one pitch ratio. dB values are relative to the input tone.
+struct ResampleQuality {
+    double passbandRippleDb;  // max - min gain over the tones that should come through
+    double stopbandDb;        // loudest alias of a tone that should have been removed, NAN if there were none
+    double aliasingDb;        // worst aliases and interpolation noise against a tone that came through
+};
+
+/// @brief Log2 of the test table length.
+static constexpr int quality_table_bits = 12;
+
+/// @brief Outputs rendered before measuring, so filters have filled with signal.
+static constexpr int quality_warmup = 512;
+
+/// @brief Outputs measured per tone.
+static constexpr int quality_window = 2048;
+
+/// @brief Output buffer a measurement needs.
+static constexpr int quality_outputs = quality_warmup + quality_window;
+
+/// @brief Highest output frequency, in cycles per sample, that counts as passband.
+static constexpr double quality_passband = 0.4;
+
+/// @brief Least squares fit of `a cos(wn) + b sin(wn) + c` to `x`.
+/// @return the power of what's left over, and the amplitude of the fit through `amplitude`
+inline double fit_sinusoid(const float *x, int count, double w, double &amplitude) {
+    // the normal equations, built with a rotating phasor so there's no trig per sample.
+    double cc = 0, ss = 0, cs = 0, c1 = 0, s1 = 0, xc = 0, xs = 0, x1 = 0, xx = 0;
+    double c = 1, s = 0;
+    const double dc = std::cos(w), ds = std::sin(w);
+    for (int n = 0; n < count; n++) {
+        cc += c * c; ss += s * s; cs += c * s;
+        c1 += c; s1 += s;
+        xc += x[n] * c; xs += x[n] * s; x1 += x[n];
+        xx += (double) x[n] * x[n];
+
+        const double next = c * dc - s * ds;
+        s = s * dc + c * ds;
+        c = next;
+    }
+
+    // solve the 3x3 system with Cramer's rule.
+    const double m[3][3] = {{cc, cs, c1}, {cs, ss, s1}, {c1, s1, (double) count}};
+    const double r[3] = {xc, xs, x1};
+    auto det = [](const double a[3][3]) {
+        return a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+             - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+             + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+    };
+
+    const double d = det(m);
+    double coef[3];
+    for (int k = 0; k < 3; k++) {
+        double mk[3][3];
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) mk[i][j] = (j == k) ? r[i] : m[i][j];
+        }
+        coef[k] = det(mk) / d;
+    }
+
+    amplitude = std::sqrt(coef[0] * coef[0] + coef[1] * coef[1]);
+
+    // the fit is a projection, so the residual is what it didn't explain.
+    const double explained = coef[0] * xc + coef[1] * xs + coef[2] * x1;
+    return std::max(0.0, xx - explained) / count;
+}
+
+/// @brief Play a stepped sine sweep through a method at one pitch ratio.
+///
+/// Each step is a full-scale tone on an exact bin of the table, so the loop is seamless. A tone
+/// that lands at or under `quality_passband` after the pitch change should come through at unity
+/// gain and nothing else, and one that lands over Nyquist, where it would fold back into the
+/// passband, should vanish.
+/// @param render the method, see above
+/// @param ratio input samples per output sample
+/// @param table scratch for the test table, `1 << quality_table_bits` samples
+/// @param out scratch for the output, `quality_outputs` samples
+/// @param steps number of tones, spaced logarithmically from 20 Hz to just under Nyquist at 44.1 kHz
+template <typename Render>
+ResampleQuality resample_quality(Render &&render, double ratio, float *table, float *out, int steps = 24) {
+    constexpr double two_pi = 6.283185307179586476925;
+    constexpr int size = 1 << quality_table_bits;
+    constexpr double tiny = 1e-30;
+
+    const int lowest = std::max(1, (int) std::lround(20.0 / 44100 * size));
+    const int highest = size / 2 - 1;
+
+    double minGain = INFINITY, maxGain = -INFINITY;
+    double stopband = -INFINITY, aliasing = -INFINITY;
+
+    int previous = 0;
+    for (int step = 0; step < steps; step++) {
+        const int bin = (int) std::lround(lowest * std::pow((double) highest / lowest, (double) step / (steps - 1)));
+        if (bin == previous) continue;
+        previous = bin;
+
+        const double inFrequency = (double) bin / size;
+        const double outFrequency = inFrequency * ratio;
+        for (int i = 0; i < size; i++) {
+            table[i] = (float) std::sin(two_pi * inFrequency * i);
+        }
+
+        render(table, quality_table_bits, ratio, out, quality_outputs);
+        const float *x = out + quality_warmup;
+
+        // what an output over Nyquist would alias to.
+        const double folded = std::fabs(outFrequency - std::round(outFrequency));
+
+        if (outFrequency > 0.5) {
+            // aliases landing up in the transition band are the filter designs' business, not ours.
+            if (folded > quality_passband) continue;
+
+            double power = 0;
+            for (int n = 0; n < quality_window; n++) power += (double) x[n] * x[n];
+            power /= quality_window;
+            stopband = std::max(stopband, 10 * std::log10(power / 0.5 + tiny));
+        }
+        else if (outFrequency <= quality_passband && inFrequency <= quality_passband) {
+            double amplitude;
+            const double residual = fit_sinusoid(x, quality_window, two_pi * outFrequency, amplitude);
+            const double gain = 20 * std::log10(amplitude + tiny);
+            minGain = std::min(minGain, gain);
+            maxGain = std::max(maxGain, gain);
+            aliasing = std::max(aliasing, 10 * std::log10((residual + tiny) / (0.5 * amplitude * amplitude + tiny)));
+        }
+    }
+
+    return ResampleQuality {
+        maxGain - minGain,
+        std::isinf(stopband) ? NAN : stopband,
+        aliasing
+    };
+}
+
+/// @brief `AudioSynthWavetable`'s interpolation, outside the audio stream: 16-bit samples, a 32-bit
+/// phase over the loop, and linear interpolation with a 16-bit weight.
+struct WavetableLinear {
+    /// @brief Convert a table to the 16-bit samples the wavetable plays.
+    static void quantize(const float *table, int16_t *samples, int size) {
+        for (int i = 0; i < size; i++) {
+            samples[i] = (int16_t) std::lround(std::max(-1.f, std::min(1.f, table[i])) * 32767);
+        }
+    }
+
+    /// @brief Same as the common `render()`, but from samples already quantized.
+    static void render(const int16_t *samples, int sizeBits, double ratio, float *out, int count) {
+        const int size = 1 << sizeBits;
+        const int fractionBits = 32 - sizeBits;
+        const uint32_t increment = (uint32_t) (ratio * (1u << fractionBits));
+
+        uint32_t phase = 0;
+        for (int n = 0; n < count; n++) {
+            const uint32_t index = phase >> fractionBits;
+            const int32_t a = samples[index], b = samples[(index + 1) & (size - 1)];
+            const int32_t weight = (phase << sizeBits) >> 16;
+
+            const int32_t mixed = (int32_t) (((int64_t) b * weight + (int64_t) a * (0xFFFF - weight)) >> 16);
+            out[n] = mixed * (1.f / 32767);
+            phase += increment;
+        }
+    }
+};
+
+/// @brief Write one result as a single line of JSON.
+/// @param cost what a sample cost, measured however the platform can
+/// @param costKey what to call it: cycles on the device, time on a host
+/// @return what snprintf returns
+inline int format_resample_report(char *line, size_t size, const char *method, double ratio, double cost, ResampleQuality const& q, const char *costKey = "cycles_per_sample") {
+    char stopband[16];
+    if (std::isnan(q.stopbandDb)) snprintf(stopband, sizeof(stopband), "null");
+    else snprintf(stopband, sizeof(stopband), "%.1f", q.stopbandDb);
+
+    return snprintf(line, size,
+        "{\"method\":\"%s\",\"ratio\":%.4g,\"%s\":%.1f,\"passband_ripple_db\":%.3f,\"stopband_db\":%s,\"aliasing_db\":%.1f}",
+        method, ratio, costKey, cost, q.passbandRippleDb, stopband, q.aliasingDb);
+}
+
+/// @brief Write a line for a ratio a method couldn't run at, in place of its result.
+/// @param reason why, for whoever reads the report
+/// @return what snprintf returns
+inline int format_resample_skipped(char *line, size_t size, const char *method, double ratio, const char *reason) {
+    return snprintf(line, size, "{\"method\":\"%s\",\"ratio\":%.4g,\"skipped\":\"%s\"}", method, ratio, reason);
+}
+
+}
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef sine_kernels_h_
+#define sine_kernels_h_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+/// Sine generators for the oscillator bank, each rendering a run of one partial.
+///
+/// Every kernel has the same interface:
+///
+///     static void render(uint32_t phase, uint32_t increment, float amp, float ampStep, int length, float *out);
+///
+/// which accumulates `(amp + ampStep * n) * sin(phase + increment * n)` into `out[n]` for `n` in
+/// `[0, length)`, with a 32-bit phase covering one cycle. They trade accuracy for speed differently;
+/// `sine_quality()` measures them. Nothing here depends on Arduino, so they can be checked off the device.
+namespace oscbank {
+
+/// @brief Phase to radians.
+static constexpr float phase_to_radians = 2 * 3.14159265358979f / 4294967296.f;
+
+/// @brief Fold a phase into [-1/4, 1/4] of a cycle, where sine is odd and monotonic, without branching.
+/// @return the folded angle, in radians
+static inline float fold_phase(uint32_t ph) {
+    const bool outer = ph >= 0x40000000u && ph < 0xC0000000u;
+    const int32_t angle = outer ? (int32_t) (0x80000000u - ph) : (int32_t) ph;
+    return angle * phase_to_radians;
+}
+
+/// @brief 11th order Taylor series, in float. Same accuracy as the fixed-point `taylor()`.
+struct Taylor {
+    static inline float sin(uint32_t ph) {
+        const float x = fold_phase(ph);
+        const float x2 = x * x;
+        return x * (1 + x2 * (-1.f / 6 + x2 * (1.f / 120 + x2 * (-1.f / 5040 + x2 * (1.f / 362880 + x2 * (-1.f / 39916800))))));
+    }
+
+    static void render(uint32_t phase, uint32_t increment, float amp, float ampStep, int length, float *out) {
+        for (int n = 0; n < length; n++) {
+            out[n] += (amp + ampStep * n) * sin(phase + increment * n);
+        }
+    }
+};
+
+/// @brief 5th order minimax polynomial. Cheaper than `Taylor`, with errors around 7e-5 (-83 dB).
+struct Minimax {
+    static inline float sin(uint32_t ph) {
+        const float x = fold_phase(ph);
+        const float x2 = x * x;
+        return x * (0.99969677f + x2 * (-0.16567308f + x2 * 0.0075143772f));
+    }
+
+    static void render(uint32_t phase, uint32_t increment, float amp, float ampStep, int length, float *out) {
+        for (int n = 0; n < length; n++) {
+            out[n] += (amp + ampStep * n) * sin(phase + increment * n);
+        }
+    }
+};
+
+/// @brief Taylor series in double, good to well past float precision over [0, 2 pi), so tables
+/// can be built by the compiler.
+constexpr double series_sin(double x) {
+    constexpr double pi = 3.14159265358979323846;
+    if (x > pi) x -= 2 * pi;
+
+    double term = x, sum = x;
+    for (int k = 1; k < 24; k++) {
+        term *= -x * x / ((2 * k) * (2 * k + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+/// @brief Linearly interpolated 1024-point table. A couple of loads instead of a polynomial.
+struct Table {
+    static constexpr int size_bits = 10;
+    static constexpr int size = 1 << size_bits;
+
+    /// @brief One cycle, plus the first point again so interpolation never wraps.
+    static constexpr std::array<float, size + 1> table = [] {
+        std::array<float, size + 1> t {};
+        for (int i = 0; i <= size; i++) {
+            t[i] = series_sin(2 * 3.14159265358979323846 * (i % size) / size);
+        }
+        return t;
+    }();
+
+    static inline float sin(uint32_t ph) {
+        constexpr int fraction_bits = 32 - size_bits;
+        const uint32_t i = ph >> fraction_bits;
+        const float frac = (ph & ((1u << fraction_bits) - 1)) * (1.f / (1u << fraction_bits));
+        return table[i] + (table[i + 1] - table[i]) * frac;
+    }
+
+    static void render(uint32_t phase, uint32_t increment, float amp, float ampStep, int length, float *out) {
+        for (int n = 0; n < length; n++) {
+            out[n] += (amp + ampStep * n) * sin(phase + increment * n);
+        }
+    }
+};
+
+/// @brief Quadrature oscillator: rotates a (cos, sin) pair by the increment each sample, which is
+/// two multiplies and an add per output. Starts exactly from `Taylor` on every call, and pulls the
+/// pair back onto the unit circle every `renormalize` samples so rounding can't grow the amplitude.
+/// The phase can't be modulated within a run, which the bank never needs.
+struct Rotator {
+    static constexpr int renormalize = 8;
+
+    static void render(uint32_t phase, uint32_t increment, float amp, float ampStep, int length, float *out) {
+        float s = Taylor::sin(phase), c = Taylor::sin(phase + 0x40000000u);
+        const float ds = Taylor::sin(increment), dc = Taylor::sin(increment + 0x40000000u);
+
+        for (int n = 0; n < length; n++) {
+            out[n] += (amp + ampStep * n) * s;
+
+            const float next = s * dc + c * ds;
+            c = c * dc - s * ds;
+            s = next;
+
+            if ((n % renormalize) == renormalize - 1) {
+                // one Newton step towards 1 / |(c, s)|, plenty when it's already within rounding.
+                const float g = 1.5f - 0.5f * (s * s + c * c);
+                s *= g;
+                c *= g;
+            }
+        }
+    }
+};
+
+/// @brief A straight-line piece of envelope for each harmonic of a bank.
+struct Ramp {
+    const float *amplitude;     // each harmonic's amplitude at the first sample
+    const float *amplitudeStep; // and its change per sample
+    const float *offset;        // each harmonic's phase offset at the first sample, 0 to 2^32
+    const float *offsetStep;    // and its change per sample
+};
+
+/// @brief Render part of a block of harmonics under a linear envelope, and accumulate it into `out`.
+///
+/// Works a harmonic at a time, handing each one's run to the sine kernel. The envelope's phase
+/// offset ramp is folded into the phase increment, so it costs nothing per sample.
+/// @tparam Sine one of the kernels above
+/// @param phases each harmonic's phase accumulator at the start of the block. Not advanced.
+/// @param increments each harmonic's phase increment per sample
+/// @param ramp the envelope, starting at sample `first`
+/// @param count number of harmonics to render
+/// @param first the first sample of the block to render
+/// @param length how many samples to render
+/// @param out the whole block's output, accumulated into from sample `first`
+template <typename Sine>
+void render_block(const uint32_t *phases, const uint32_t *increments, Ramp const& ramp, int count, int first, int length, float *out) {
+    for (int h = 0; h < count; h++) {
+        // offsets span the whole 32-bit range, and a one-sample ramp can step by most of it, so
+        // go through 64 bits to wrap rather than overflow.
+        const uint32_t phase = phases[h] + increments[h] * (first + 1) + (uint32_t) (int64_t) ramp.offset[h];
+        const uint32_t increment = increments[h] + (uint32_t) (int64_t) ramp.offsetStep[h];
+
+        Sine::render(phase, increment, ramp.amplitude[h], ramp.amplitudeStep[h], length, out + first);
+    }
+}
+
+/// @brief How close a kernel gets to a pure sine.
+struct SineQuality {
+    double snrDb; // fundamental against everything else
+    double thdDb; // harmonics 2-10 against the fundamental
+};
+
+/// @brief Render a full-scale sine with a kernel, in runs of `run` samples as the bank would, and
+/// compare it with a double precision one.
+/// @tparam Kernel the kernel to measure
+/// @param cycles cycles over the whole measurement, so the harmonics land on exact bins. Keep
+/// `cycles * 10` under half the sample count.
+/// @param samples_bits log2 of the number of samples to measure
+/// @param run samples per `render()` call, normally the audio block size
+template <typename Kernel>
+SineQuality sine_quality(uint32_t cycles, int samples_bits = 12, int run = 32) {
+    constexpr double two_pi = 6.283185307179586476925;
+    constexpr int harmonics = 10;
+
+    const int samples = 1 << samples_bits;
+    const uint32_t increment = cycles << (32 - samples_bits);
+
+    double signal = 0, error = 0;
+    double re[harmonics + 1] {}, im[harmonics + 1] {};
+
+    float chunk[256];
+    if (run > 256) run = 256;
+
+    for (int start = 0; start < samples; start += run) {
+        const int length = std::min(run, samples - start);
+        std::fill(chunk, chunk + length, 0.f);
+        Kernel::render(increment * start, increment, 1.f, 0.f, length, chunk);
+
+        for (int i = 0; i < length; i++) {
+            const uint32_t n = start + i;
+            const double exact = std::sin(two_pi * (uint32_t) (increment * n) / 4294967296.0);
+            signal += exact * exact;
+            error += (chunk[i] - exact) * (chunk[i] - exact);
+
+            for (int h = 1; h <= harmonics; h++) {
+                const double angle = two_pi * (uint32_t) (increment * n * h) / 4294967296.0;
+                re[h] += chunk[i] * std::cos(angle);
+                im[h] += chunk[i] * std::sin(angle);
+            }
+        }
+    }
+
+    double distortion = 0;
+    for (int h = 2; h <= harmonics; h++) {
+        distortion += re[h] * re[h] + im[h] * im[h];
+    }
+    const double fundamental = re[1] * re[1] + im[1] * im[1];
+
+    constexpr double tiny = 1e-30;
+    return SineQuality {
+        10 * std::log10((signal + tiny) / (error + tiny)),
+        10 * std::log10((distortion + tiny) / (fundamental + tiny))
+    };
+}
+
+}
+
+#endif
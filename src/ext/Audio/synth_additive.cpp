@@ -1,5 +1,6 @@
 #include "synth_additive.h"
 #include <algorithm>
+#include <new>
 #include "utility/dspinst.h"
 
 
@@ -11,15 +12,6 @@ constexpr auto fast_cos = arm_cos_f32;
 
 namespace resample {
 
-/// @brief A pointer to a signal buffer and its length.
-struct buffer {
-    float *t;
-    int len;
-};
-
-/// @brief Sample function definition. Takes an integer offset between -int_max and int_max.
-using sample_func = float (*)(int, buffer);
-
 /// @brief Sample from a buffer which is defined as zero everywhere except i = [0, wave.len - 1].
 float sample_oneshot(int i, buffer wave) {
     if (i < 0 || i >= wave.len) {
@@ -137,7 +129,7 @@ inline float fract_part(float x) {
 /// @param samplePolicy one of the sample_func above, or something similar.
 /// @param phase phase offset (in the input signal) to start playing.
 /// @return the ending phase within the input buffer, pass back to this function to continue seamless playback within `input` on subsequent calls.
-inline float windowed_sinc_interpolation(buffer input, buffer output, float inputSampleRate, float outputSampleRate, sample_func samplePolicy, float phase, bool profile) {
+float windowed_sinc_interpolation(buffer input, buffer output, float inputSampleRate, float outputSampleRate, sample_func samplePolicy, float phase, bool profile) {
     const int windowSize = 8;
     const int halfWindow = windowSize / 2;
 
@@ -195,21 +187,357 @@ inline float pitch_shift_single_cycle(buffer loop, buffer stream, float nativeSa
 
 
 
+/// @brief If this is throwing up problems, you've tried to initialize an FFT with an unsupported size.
+template<bool flag = false> void static_no_match() { static_assert(flag, "FFT size (`N`) not supported."); }
+
+template <int N>
+void init_fft(arm_rfft_fast_instance_f32 &fftInstance) {
+    if constexpr (N == 32) {
+        arm_rfft_fast_init_32_f32(&fftInstance);
+    }
+    else if constexpr (N == 64) {
+        arm_rfft_fast_init_64_f32(&fftInstance);
+    }
+    else if constexpr (N == 128) {
+        arm_rfft_fast_init_128_f32(&fftInstance);
+    }
+    else if constexpr (N == 256) {
+        arm_rfft_fast_init_256_f32(&fftInstance);
+    }
+    else if constexpr (N == 512) {
+        arm_rfft_fast_init_512_f32(&fftInstance);
+    }
+    else if constexpr (N == 1024) {
+        arm_rfft_fast_init_1024_f32(&fftInstance);
+    }
+    else if constexpr (N == 2048) {
+        arm_rfft_fast_init_2048_f32(&fftInstance);
+    }
+    else if constexpr (N == 4096) {
+        arm_rfft_fast_init_4096_f32(&fftInstance);
+    }
+    else {
+        static_no_match();
+    }
+}
+
 void GrainEvent::execute() {
-    synth->partials()[random(64, 128)] = random(6, 40);
-    synth->reapGrain();
-    delete this;
+    synth->grainFired(this);
 }
 
 
 void AudioSynthAdditive::clearPartials() {
-    std::fill(partialTable.begin(), partialTable.end(), 0.f);
+    if (!wavetable) return;
+    partials()->clear();
+    partialsChanged();
+}
+
+namespace additive {
+
+int find_sparse_partials(const float *partials, int tableSize, SparsePartial *out, int capacity) {
+    const float dcScale = 1.f / tableSize;
+    const float binScale = 2.f / tableSize;
+
+    int count = 0;
+    auto add = [&](int bin, float re, float im) {
+        if (count >= capacity) return false;
+        out[count++] = SparsePartial {bin, re, im};
+        return true;
+    };
+
+    // DC and Nyquist are packed together in the first slot, and are purely real. We keep the
+    // output sorted by bin, so Nyquist goes on the end.
+    if (partials[0] != 0 && !add(0, partials[0] * dcScale, 0)) return -1;
+
+    for (int k = 1; k < tableSize / 2; k++) {
+        float re = partials[k * 2];
+        float im = partials[k * 2 + 1];
+        if (re == 0 && im == 0) continue;
+
+        if (!add(k, re * binScale, im * binScale)) return -1;
+    }
+
+    if (partials[1] != 0 && !add(tableSize / 2, partials[1] * dcScale, 0)) return -1;
+
+    return count;
+}
+
+/// @brief sin(2πt) for any t. No branches or tables, so a run of these pipelines nicely.
+static inline float sin_turns(float t) {
+    constexpr float twoPi = 2 * (float) PI;
+
+    t -= roundf(t); // [-0.5, 0.5]
+
+    // fold into [-0.25, 0.25], which has the same sine, so a short polynomial is accurate.
+    const float a = fabsf(t);
+    const float x = twoPi * copysignf(a > 0.25f ? 0.5f - a : a, t);
+    const float x2 = x * x;
+
+    return x * (1 + x2 * (-1.f / 6 + x2 * (1.f / 120 + x2 * (-1.f / 5040 + x2 * (1.f / 362880)))));
+}
+
+void polar_to_cartesian(const float *amplitude, const float *phase, float *out, int count) {
+    constexpr float turnsPerRadian = 1 / (2 * (float) PI);
+
+    for (int i = 0; i < count; i++) {
+        const float t = phase[i] * turnsPerRadian;
+        out[i * 2] = amplitude[i] * sin_turns(t + 0.25f);
+        out[i * 2 + 1] = amplitude[i] * sin_turns(t);
+    }
+}
+
+GrainWindows::GrainWindows() {
+    for (int i = 0; i <= size; i++) {
+        const float x = (float) i / size; // 0-1 across the grain
+
+        // cosine edges over the first and last 10%, flat between.
+        constexpr float tukeyEdge = 0.1f;
+        float tukey = 1;
+        if (x < tukeyEdge) tukey = 0.5f - 0.5f * cosf((float) PI * x / tukeyEdge);
+        else if (x > 1 - tukeyEdge) tukey = 0.5f - 0.5f * cosf((float) PI * (1 - x) / tukeyEdge);
+
+        table[(int) GrainWindow::hann * (size + 1) + i] = 0.5f - 0.5f * cosf(2 * (float) PI * x);
+        table[(int) GrainWindow::triangle * (size + 1) + i] = 1 - fabsf(2 * x - 1);
+        table[(int) GrainWindow::tukey * (size + 1) + i] = tukey;
+        // about -60 dB by the end, then forced to 0 so it can't click.
+        table[(int) GrainWindow::decay * (size + 1) + i] = i == size ? 0 : expf(-6.9f * x);
+    }
+}
+
+void render_sparse(const SparsePartial *partials, int count, float *out, int tableSize) {
+    // How often to re-seed the phasors from the exact phase, so rounding can't accumulate.
+    constexpr int reseedInterval = 256;
+    // How many oscillators we run side by side. Four phasors' worth of state fits in registers.
+    constexpr int lanes = 4;
+
+    const float radiansPerBin = 2 * PI / tableSize;
+    const int tableMask = tableSize - 1;
+
+    std::fill(out, out + tableSize, 0.f);
+
+    for (int first = 0; first < count; first += lanes) {
+        float re[lanes] {}, im[lanes] {}, c[lanes] {}, s[lanes] {};
+        float seedRe[lanes] {}, seedIm[lanes] {};
+        int bin[lanes] {};
+
+        for (int j = 0; j < lanes && first + j < count; j++) {
+            auto const& p = partials[first + j];
+            bin[j] = p.bin;
+            seedRe[j] = p.re;
+            seedIm[j] = p.im;
+            c[j] = fast_cos(radiansPerBin * p.bin);
+            s[j] = fast_sin(radiansPerBin * p.bin);
+        }
+
+        for (int n0 = 0; n0 < tableSize; n0 += reseedInterval) {
+            for (int j = 0; j < lanes; j++) {
+                // bins are integral, so the exact phase wraps cleanly on the table length.
+                float theta = radiansPerBin * ((bin[j] * n0) & tableMask);
+                float ct = fast_cos(theta), st = fast_sin(theta);
+                re[j] = seedRe[j] * ct - seedIm[j] * st;
+                im[j] = seedRe[j] * st + seedIm[j] * ct;
+            }
+
+            const int end = std::min(n0 + reseedInterval, tableSize);
+            for (int n = n0; n < end; n++) {
+                float accum = 0;
+                for (int j = 0; j < lanes; j++) {
+                    accum += re[j];
+                    float r = re[j] * c[j] - im[j] * s[j];
+                    im[j] = re[j] * s[j] + im[j] * c[j];
+                    re[j] = r;
+                }
+                out[n] += accum;
+            }
+        }
+    }
+}
+
+} // namespace additive
+
+
+/// @brief Initialize the rfft for mip level `Level` and every level after it.
+template <int Level>
+void init_mip_ffts(arm_rfft_fast_instance_f32 *instances) {
+    if constexpr (Level < AudioSynthAdditive::mip_levels) {
+        init_fft<AudioSynthAdditive::Mips::size(Level)>(instances[Level]);
+        init_mip_ffts<Level + 1>(instances);
+    }
+}
+
+const AudioSynthAdditive::Resampler AudioSynthAdditive::resampler {};
+
+const additive::GrainWindows AudioSynthAdditive::grainWindows {};
+
+AudioSynthAdditive::AudioSynthAdditive() : AudioStream(0, nullptr) {
+    // The larger FFT tables get really big. `init_fft` is `if constexpr` all the way down, so we
+    // only pull in the tables for the sizes we actually use.
+    init_mip_ffts<0>(fftInstances.data());
+
+    // K frames of spectra and tables won't fit in RAM2 for long. Big wavetables go in PSRAM.
+#if ADDITIVE_FRAMES_IN_EXTMEM
+    wavetable = (Wavetable*) extmem_calloc(1, sizeof(Wavetable));
+#else
+    wavetable = (Wavetable*) calloc(1, sizeof(Wavetable));
+#endif
+    if (!wavetable) return;
+    new (wavetable) Wavetable; // the arrays stay zeroed; this just sets up the dirty ranges.
+
+    for (int i = 0; i < n_frames; i++) {
+        frames[i] = &wavetable->tables[i];
+        frameGeneration[i] = 1; // everything starts dirty, so `service()` renders it once.
+    }
+    spare = &wavetable->tables[n_frames];
+}
+
+void AudioSynthAdditive::renderFrame(Spectrum const& partialTable, MipTable &out) {
+    // A handful of partials is cheaper to run as oscillators than as a full-sized IFFT.
+    int nSparse = additive::find_sparse_partials(partialTable.data(), partial_table_size, sparsePartials.data(), sparseLimit);
+    if (nSparse >= 0) {
+        // partials are sorted by bin, so each level just takes a shorter prefix.
+        for (int level = 0; level < mip_levels; level++) {
+            int count = 0;
+            while (count < nSparse && sparsePartials[count].bin <= Mips::top_partial(level)) {
+                count++;
+            }
+            additive::render_sparse(sparsePartials.data(), count, out.data() + Mips::offset(level), Mips::size(level));
+        }
+        return;
+    }
+
+    for (int level = 0; level < mip_levels; level++) {
+        const int size = Mips::size(level);
+        const int topPartial = std::min(Mips::top_partial(level), size / 2 - 1);
+
+        // The inverse rfft scales by 1/size, so bring smaller levels back up to the same amplitude.
+        const float scale = (float) size / partial_table_size;
+
+        // the rfft scribbles all over its input, so give it a copy. Only the full-sized level
+        // keeps the Nyquist bin; everything else is low-passed below its own Nyquist.
+        fftWorkspace[0] = partialTable[0] * scale;
+        fftWorkspace[1] = level ? 0.f : partialTable[1] * scale;
+        for (int i = 2; i < (topPartial + 1) * 2; i++) {
+            fftWorkspace[i] = partialTable[i] * scale;
+        }
+        std::fill(fftWorkspace.begin() + (topPartial + 1) * 2, fftWorkspace.begin() + size, 0.f);
+
+        arm_rfft_fast_f32(&fftInstances[level], fftWorkspace.data(), out.data() + Mips::offset(level), 1);
+    }
+}
+
+void AudioSynthAdditive::service() {
+    // One frame per call, and only into the spare table. The audio thread hands the spare back
+    // once it's done fading away from the table it replaced.
+    if (!wavetable || pendingFrame >= 0 || !spare) return;
+
+    for (int k = 0; k < n_frames; k++) {
+        const uint32_t generation = frameGeneration[k];
+        if (generation == renderedGeneration[k]) continue;
+
+        // partials are only written from `loop()`, as is this, so the dirty range can't move under us.
+        auto& partials = wavetable->partials[k];
+        auto [begin, end] = partials.take_dirty();
+        partials.to_cartesian(wavetable->spectra[k].data(), begin, end);
+
+        MipTable *target = spare;
+        spare = nullptr;
+
+        renderFrame(wavetable->spectra[k], *target);
+        renderedGeneration[k] = generation;
+
+        // publish the table before the frame number; the audio thread keys off `pendingFrame`.
+        pendingTable = target;
+        __DSB();
+        pendingFrame = k;
+        return;
+    }
+}
+
+void AudioSynthAdditive::noteOn(int note, float f, float amplitude) {
+    if (f > systemNyquistFrequency) {
+        f = systemNyquistFrequency;
+    }
+
+    uint32_t increment = f * (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT);
+    int level = Mips::level_for(f / fundamental_frequency);
+
+    __disable_irq();
+    grainFrequency = f;
+    voices.start(note, increment, level, amplitude);
+    __enable_irq();
+}
+
+void AudioSynthAdditive::noteOff(int note) {
+    __disable_irq();
+    voices.stop(note);
+    __enable_irq();
+}
+
+void AudioSynthAdditive::envelope(float attackMs, float releaseMs) {
+    constexpr float samplesPerMs = AUDIO_SAMPLE_RATE_EXACT / 1000.f;
+
+    __disable_irq();
+    voices.attackSamples = attackMs * samplesPerMs;
+    voices.releaseSamples = releaseMs * samplesPerMs;
+    __enable_irq();
+}
+
+void AudioSynthAdditive::grains(GrainParams const& params) {
+    __disable_irq();
+    grainParams = params;
+    __enable_irq();
+}
+
+/// @brief Uniform random float in [0, 1).
+static float random_unit() {
+    return random(0, 65536) / 65536.f;
+}
+
+Tick AudioSynthAdditive::nextGrainDelay() {
+    // spacing is uniform over [0.5, 1.5] of the mean, so clouds don't pulse at a fixed rate.
+    const float mean = AUDIO_SAMPLE_RATE_EXACT / grainParams.density;
+    return std::max(1.f, mean * (0.5f + random_unit()));
 }
 
 void AudioSynthAdditive::scheduleGrain() {
-    if (grainsOut < 10) {
-        grainsOut++;
-        grainScheduler.schedule(new GrainEvent {this}, random(AUDIO_BLOCK_SAMPLES * 500, AUDIO_BLOCK_SAMPLES * 5000));
+    // one event drives the whole cloud, rescheduling itself as each grain starts.
+    if (grainParams.density <= 0 || grainEvents.inUse()) return;
+
+    if (auto event = grainEvents.acquire(this)) {
+        grainScheduler.schedule(event, nextGrainDelay());
+    }
+}
+
+void AudioSynthAdditive::grainFired(GrainEvent *event) {
+    auto const& p = grainParams;
+
+    const float f = std::min(grainFrequency * p.ratio * exp2f(p.ratioSpread * (2 * random_unit() - 1)), systemNyquistFrequency);
+    const int duration = std::max(1.f, p.durationMs * (AUDIO_SAMPLE_RATE_EXACT / 1000.f));
+    const float pan = p.panSpread * (2 * random_unit() - 1);
+
+    additive::Grain grain;
+    // offset and spread are both up to 1, so the start can run past the end of the cycle. Going
+    // through int64_t keeps that in range, and the conversion to uint32_t wraps it back round.
+    const float start = p.offset + p.offsetSpread * random_unit();
+    grain.phase = (uint32_t) (int64_t) (start * 4294967296.f);
+    grain.increment = f * (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT);
+    grain.mipLevel = Mips::level_for(f / fundamental_frequency);
+    grain.window = 0;
+    grain.windowStep = (float) additive::GrainWindows::size / duration;
+    grain.remaining = duration;
+    grain.delay = grainScheduler.block_offset();
+    // center is full level on both sides, so mono listeners hear the same thing at any pan.
+    grain.gainLeft = p.amplitude * std::min(1.f, 1 - pan);
+    grain.gainRight = p.amplitude * std::min(1.f, 1 + pan);
+    grain.shape = p.window;
+
+    grainCloud.spawn(grain);
+
+    if (p.density > 0) {
+        grainScheduler.schedule(event, nextGrainDelay());
+    }
+    else {
+        grainEvents.release(event);
     }
 }
 
@@ -220,25 +548,65 @@ void AudioSynthAdditive::update() {
     auto block = allocate();
     if (!block) return;
 
-    // super naive additive algorithm follows for now, lol
+    if (!wavetable) {
+        release(block);
+        return;
+    }
 
-    decltype(partialTable) workingArray;
-    memcpy(workingArray.data(), partialTable.data(), sizeof(float) * partialTable.size());
+    // `service()` renders edited frames in the background. Swap them in at the block boundary
+    // and fade over from the old table, so edits don't click. If we're still fading from the
+    // last swap, the new one waits for a following block.
+    const int pending = pendingFrame;
+    if (pending >= 0 && !crossfadeRemaining) {
+        fadingFrame = pending;
+        fadingTable = frames[pending];
+        frames[pending] = pendingTable;
+        pendingFrame = -1;
+        crossfadeRemaining = crossfade_samples;
+    }
 
-    // calculate the waveform for this frame
-    arm_rfft_fast_f32(&fftInstance, workingArray.data(), signal.data(), 1);
+    const int from = std::min((int) scanPosition, n_frames - 1);
+    const int to = std::min(from + 1, n_frames - 1);
+
+    additive::VoiceSource source;
+    source.from = frames[from]->data();
+    source.to = frames[to]->data();
+    source.morph = scanPosition - from;
+    source.fadeFrom = fadingFrame == from ? fadingTable->data() : source.from;
+    source.fadeTo = fadingFrame == to ? fadingTable->data() : source.to;
+    source.fadeRemaining = (fadingFrame == from || fadingFrame == to) ? crossfadeRemaining : 0;
+    source.fadeLength = crossfade_samples;
+
+    // grains are still timed to the sample, but a block with nothing due costs next to nothing.
+    grainScheduler.advance_block(AUDIO_BLOCK_SAMPLES);
+
+    float left[AUDIO_BLOCK_SAMPLES] {};
+    voices.render<Mips>(resampler, source, left);
+
+    float right[AUDIO_BLOCK_SAMPLES];
+    std::copy(left, left + AUDIO_BLOCK_SAMPLES, right);
+    grainCloud.render<Mips>(resampler, grainWindows, source, left, right);
+
+    crossfadeRemaining = std::max(0, crossfadeRemaining - AUDIO_BLOCK_SAMPLES);
+    if (!crossfadeRemaining && fadingTable) {
+        spare = fadingTable;
+        fadingTable = nullptr;
+        fadingFrame = -1;
+    }
 
-    int si = rawPlaybackPhase;
     for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
-        grainScheduler.advance(1);
-        int s =  32000 * signal.data()[si];
-        block->data[i] = s;
-        si = (si + 1) % signal_table_size;
+        block->data[i] = saturate16(32000 * left[i]);
     }
-    rawPlaybackPhase = si;
-
-    transmit(block);
+    transmit(block, 0);
     release(block);
+
+    if (auto rightBlock = allocate()) {
+        for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+            rightBlock->data[i] = saturate16(32000 * right[i]);
+        }
+        transmit(rightBlock, 1);
+        release(rightBlock);
+    }
 }
 
 // =====================================================================
@@ -279,23 +647,31 @@ float taylorf(uint32_t ph) {
 }
 
 
-void AudioSynthOscBank::frequency(int bank, float f) {
+template <int Harmonics, typename Sine>
+void AudioSynthOscBankN<Harmonics, Sine>::frequency(int bank, float f) {
     banks[bank].frequency(f);
 }
 
-void AudioSynthOscBank::Bank::frequency(float f) {
-    constexpr float systemPhaseConstant = (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT);
-
+template <int Harmonics, typename Sine>
+void AudioSynthOscBankN<Harmonics, Sine>::Bank::frequency(float f) {
     if (f > systemNyquistFrequency) {
         f = systemNyquistFrequency;
     }
 
-    fundamental = f;
-    
+    if (f != fundamental) {
+        fundamental = f;
+        retune = true;
+    }
+}
+
+template <int Harmonics, typename Sine>
+void AudioSynthOscBankN<Harmonics, Sine>::Bank::tune(const float *ratios) {
+    constexpr float systemPhaseConstant = (4294967296.0f / AUDIO_SAMPLE_RATE_EXACT);
+
     cutoff = -1;
 
     for (int i = 0; i < bankSize; i++) {
-        float harmonicFreq = f * (i + 1);
+        float harmonicFreq = fundamental * ratios[i];
         phaseIncrements[i] = harmonicFreq * systemPhaseConstant;
 
         if (cutoff < 0 && harmonicFreq > systemNyquistFrequency) {
@@ -306,95 +682,240 @@ void AudioSynthOscBank::Bank::frequency(float f) {
     if (cutoff < 0) {
         cutoff = bankSize;
     }
+
+    retune = false;
 }
 
-void AudioSynthOscBank::Bank::update() {
+template <int Harmonics, typename Sine>
+void AudioSynthOscBankN<Harmonics, Sine>::Bank::advance(int samples) {
     for (int i = 0; i < bankSize; i++) {
-        accumulators[i] += phaseIncrements[i];
+        accumulators[i] += phaseIncrements[i] * samples;
     }
 }
 
-float AudioSynthOscBank::sample(Bank &b) {
-    float accum = 0;
+namespace oscbank {
 
-    for (int i = 0; i < b.cutoff; i++) {
-        //accum += voice.amplitudes[i] * taylorf(b.accumulators[i] + voice.phaseOffsets[i]);
-        accum += voiceInterpolator.a[i] * taylorf(b.accumulators[i] + voiceInterpolator.a[i + bankSize]);
+void render_reference(const uint32_t *phases, const uint32_t *increments, const float *amplitude, const uint32_t *offset, int count, float *out) {
+    for (int n = 0; n < AUDIO_BLOCK_SAMPLES; n++) {
+        float accum = 0;
+        for (int h = 0; h < count; h++) {
+            const uint32_t phase = phases[h] + increments[h] * (n + 1);
+            accum += amplitude[h * AUDIO_BLOCK_SAMPLES + n] * taylorf(phase + offset[h * AUDIO_BLOCK_SAMPLES + n]);
+        }
+        out[n] += accum;
     }
+}
 
-    return accum;
 }
 
-void AudioSynthOscBank::update() {
-    auto block = allocate();
-    if (!block) return;
+template <int Harmonics, typename Sine>
+void AudioSynthOscBankN<Harmonics, Sine>::partialRatios(const float *ratios) {
+    for (int i = 0; i < bankSize; i++) {
+        editing.ratios[i] = ratios ? ratios[i] : i + 1;
+    }
+    voiceChanged();
+}
 
-    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
-        voiceInterpolator.next();
+template <int Harmonics, typename Sine>
+void AudioSynthOscBankN<Harmonics, Sine>::service() {
+    // the audio thread only moves `live` when something's pending, so while nothing is, the
+    // other copy is ours to write.
+    if (!editingChanged || pending) return;
 
-        float s = 0;
-        for (int j = 0; j < nBanks; j++) {
-            banks[j].update();
-            if (banks[j].active)
-                s += sample(banks[j]);
-        }
+    VoicePrototype *spare = live == &voices[0] ? &voices[1] : &voices[0];
+    *spare = editing;
+    editingChanged = false;
 
-        block->data[i] = s * 32000;
-    }
+    __DSB();
+    pending = spare;
+}
 
-    transmit(block);
-    release(block);
+template <int Harmonics, typename Sine>
+float AudioSynthOscBankN<Harmonics, Sine>::level(int bank) const {
+    float sum = 0;
+    for (int h = 0; h < bankSize; h++) {
+        sum += fabsf(envelopes[bank].a[h]);
+    }
+    return sum;
 }
 
-void AudioSynthOscBank::previewVoice(float *out, int nSamples) {
-    Bank tempBank;
-    for (int i = 0; i < bankSize; i++) {
-        tempBank.phaseIncrements[i] = (i + 1) * (4294967296.0f / (nSamples));
+template <int Harmonics, typename Sine>
+int AudioSynthOscBankN<Harmonics, Sine>::allocateBank(int note) {
+    // the same note again just retriggers.
+    for (int i = 0; i < nBanks; i++) {
+        if (banks[i].active && banks[i].note == note && !envelopes[i].released()) return i;
     }
-    tempBank.cutoff = bankSize;
 
-    for (int i = 0; i < nSamples; i++) {
-        tempBank.update();       
-        out[i] = sample(tempBank);
+    // then any idle bank, then any bank that's on its way out.
+    for (auto busy : {false, true}) {
+        for (int n = 0; n < nBanks; n++) {
+            const int i = (nextBank + n) % nBanks;
+            if (banks[i].active == busy && (!busy || envelopes[i].released())) return i;
+        }
     }
-}
 
-// ================================================================
+    switch (stealPolicy) {
+    case Stealing::oldest:
+        return std::min_element(banks.begin(), banks.end(), [](Bank const& x, Bank const& y) {
+            return x.startedAt < y.startedAt;
+        }) - banks.begin();
 
-/// @brief If this is throwing up problems, you've tried to initialize an FFT with an unsupported size.
-template<bool flag = false> void static_no_match() { static_assert(flag, "FFT size (`N`) not supported."); }
+    case Stealing::quietest: {
+        int quietest = 0;
+        for (int i = 1; i < nBanks; i++) {
+            if (level(i) < level(quietest)) quietest = i;
+        }
+        return quietest;
+    }
 
-template <int N>
-void init_fft(arm_rfft_fast_instance_f32 &fftInstance) {
-    if constexpr (N == 32) {
-        arm_rfft_fast_init_32_f32(&fftInstance);
+    case Stealing::roundRobin:
+    default:
+        return nextBank;
     }
-    else if constexpr (N == 64) {
-        arm_rfft_fast_init_64_f32(&fftInstance);
+}
+
+template <int Harmonics, typename Sine>
+void AudioSynthOscBankN<Harmonics, Sine>::noteOn(int note, float f) {
+    __disable_irq();
+    const int i = allocateBank(note);
+    auto &b = banks[i];
+
+    b.frequency(f);
+    envelopes[i].restart();
+    // start every harmonic from zero, so the voice's phase offsets mean what they say.
+    b.accumulators.fill(0);
+    b.note = note;
+    b.startedAt = noteCounter++;
+    b.active = true;
+
+    nextBank = (i + 1) % nBanks;
+    __enable_irq();
+}
+
+template <int Harmonics, typename Sine>
+void AudioSynthOscBankN<Harmonics, Sine>::noteOff(int note) {
+    __disable_irq();
+    for (int i = 0; i < nBanks; i++) {
+        if (banks[i].active && banks[i].note == note && !envelopes[i].released()) {
+            envelopes[i].zero(releaseSamples);
+        }
     }
-    else if constexpr (N == 128) {
-        arm_rfft_fast_init_128_f32(&fftInstance);
+    __enable_irq();
+}
+
+template <int Harmonics, typename Sine>
+void AudioSynthOscBankN<Harmonics, Sine>::update() {
+    auto block = allocate();
+    if (!block) return;
+
+    float out[AUDIO_BLOCK_SAMPLES] {};
+
+    // take up a newly published voice, for the whole block.
+    bool retuneAll = false;
+    if (pending) {
+        live = pending;
+        pending = nullptr;
+        retuneAll = true;
     }
-    else if constexpr (N == 256) {
-        arm_rfft_fast_init_256_f32(&fftInstance);
+
+    // how far through the block each bank has got. Idle banks are already done, and cost nothing:
+    // no envelope, no kernel, not even a phase update.
+    int position[nBanks], remaining[nBanks], lengths[nBanks];
+    for (int i = 0; i < nBanks; i++) {
+        position[i] = banks[i].active ? 0 : AUDIO_BLOCK_SAMPLES;
+
+        // the increments and cutoff only change with pitch, so don't rescan them every block.
+        banks[i].retune |= retuneAll;
+        if (banks[i].active && banks[i].retune) {
+            banks[i].tune(live->ratios.data());
+        }
     }
-    else if constexpr (N == 512) {
-        arm_rfft_fast_init_512_f32(&fftInstance);
+
+    // step every bank's envelope, then run the kernels. Usually one piece covers the whole block;
+    // a control point or the end of a release splits it and takes another round.
+    for (bool more = true; more; ) {
+        more = false;
+        for (int i = 0; i < nBanks; i++) {
+            remaining[i] = AUDIO_BLOCK_SAMPLES - position[i];
+        }
+
+        live->envelope.spans(envelopes.data(), remaining, nBanks, envelopeStart.data(), envelopeStep.data(), lengths);
+
+        for (int i = 0; i < nBanks; i++) {
+            if (!lengths[i]) continue;
+
+            const float *start = envelopeStart.data() + i * bankSize * 2;
+            const float *step = envelopeStep.data() + i * bankSize * 2;
+            const oscbank::Ramp ramp {start, step, start + bankSize, step + bankSize};
+
+            auto &b = banks[i];
+            oscbank::render_block<Sine>(b.accumulators.data(), b.phaseIncrements.data(), ramp, b.cutoff, position[i], lengths[i], out);
+
+            position[i] += lengths[i];
+            more |= position[i] < AUDIO_BLOCK_SAMPLES;
+        }
     }
-    else if constexpr (N == 1024) {
-        arm_rfft_fast_init_1024_f32(&fftInstance);
+
+    for (int i = 0; i < nBanks; i++) {
+        auto &b = banks[i];
+        if (!b.active) continue;
+
+        b.advance(AUDIO_BLOCK_SAMPLES);
+
+        if (envelopes[i].finished()) {
+            b.active = false;
+            b.note = -1;
+        }
     }
-    else if constexpr (N == 2048) {
-        arm_rfft_fast_init_2048_f32(&fftInstance);
+
+    for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        block->data[i] = out[i] * 32000;
     }
-    else if constexpr (N == 4096) {
-        arm_rfft_fast_init_4096_f32(&fftInstance);
+
+    transmit(block);
+    release(block);
+}
+
+template <int Harmonics, typename Sine>
+void AudioSynthOscBankN<Harmonics, Sine>::previewVoice(float *out, int nSamples, int point) {
+    Bank tempBank;
+    for (int i = 0; i < bankSize; i++) {
+        tempBank.phaseIncrements[i] = editing.ratios[i] * (4294967296.0f / (nSamples));
     }
-    else {
-        static_no_match();
+    tempBank.cutoff = bankSize;
+
+    // hold the envelope at the control point.
+    const float flat[bankSize] {};
+    const float *values = editing.envelope[point].a;
+    const oscbank::Ramp ramp {values, flat, values + bankSize, flat};
+
+    for (int i = 0; i < nSamples; i += AUDIO_BLOCK_SAMPLES) {
+        float chunk[AUDIO_BLOCK_SAMPLES] {};
+        oscbank::render_block<Sine>(tempBank.accumulators.data(), tempBank.phaseIncrements.data(), ramp, tempBank.cutoff, 0, AUDIO_BLOCK_SAMPLES, chunk);
+        tempBank.advance(AUDIO_BLOCK_SAMPLES);
+
+        std::copy_n(chunk, std::min(AUDIO_BLOCK_SAMPLES, nSamples - i), out + i);
     }
 }
 
+template class AudioSynthOscBankN<16, oscbank::Taylor>;
+template class AudioSynthOscBankN<32, oscbank::Taylor>;
+template class AudioSynthOscBankN<64, oscbank::Taylor>;
+
+template class AudioSynthOscBankN<16, oscbank::Minimax>;
+template class AudioSynthOscBankN<32, oscbank::Minimax>;
+template class AudioSynthOscBankN<64, oscbank::Minimax>;
+
+template class AudioSynthOscBankN<16, oscbank::Table>;
+template class AudioSynthOscBankN<32, oscbank::Table>;
+template class AudioSynthOscBankN<64, oscbank::Table>;
+
+template class AudioSynthOscBankN<16, oscbank::Rotator>;
+template class AudioSynthOscBankN<32, oscbank::Rotator>;
+template class AudioSynthOscBankN<64, oscbank::Rotator>;
+
+// ================================================================
+
 // AudioSynthIFFTBank::AudioSynthIFFTBank() : AudioStream(0, nullptr) {
 //     init_fft<fftBufferLength>(fftInstance);
 // }
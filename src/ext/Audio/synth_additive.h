@@ -6,19 +6,462 @@
 #include <AudioStream.h> // github.com/PaulStoffregen/cores/blob/master/teensy4/AudioStream.h
 #include <arm_math.h>    
 #include <array>
+#include <utility>
 
 #include "timer-wheel.h"
+#include "event-pool.h"
+#include "polyphase.h"
+#include "sine-kernels.h"
 
 /// @brief What's the Nyquist frequency for the environment?
 static constexpr auto systemNyquistFrequency = AUDIO_SAMPLE_RATE_EXACT / 2.f;
 
-class AudioSynthAdditive;
+/// @brief At or below this many non-zero partials, `AudioSynthAdditive` renders with oscillators instead
+/// of the IFFT. Run the `teensy41_bench` environment to measure the crossover for your build.
+#ifndef ADDITIVE_SPARSE_CROSSOVER
+#define ADDITIVE_SPARSE_CROSSOVER 8
+#endif
+
+namespace resample {
+
+/// @brief A pointer to a signal buffer and its length.
+struct buffer {
+    float *t;
+    int len;
+};
+
+/// @brief Sample function definition. Takes an integer offset between -int_max and int_max.
+using sample_func = float (*)(int, buffer);
+
+/// @brief Sample from a buffer which is defined as zero everywhere except i = [0, wave.len - 1].
+float sample_oneshot(int i, buffer wave);
+
+/// @brief Sample from a buffer which is treated as an infinite loop.
+float sample_loop(int k, buffer wave);
+
+/// @brief Resample `input` into `output` with a windowed sinc, computed per sample. See synth_additive.cpp.
+float windowed_sinc_interpolation(buffer input, buffer output, float inputSampleRate, float outputSampleRate, sample_func samplePolicy, float phase, bool profile);
 
+}
 
-class Grain {
+namespace additive {
 
+/// @brief A single non-zero bin of a packed rfft table, pre-scaled for the oscillator kernel.
+struct SparsePartial {
+    int bin;
+    float re, im;
 };
 
+/// @brief Collect the non-zero bins of a packed (`arm_rfft_fast_f32` layout) partial table.
+/// @param partials the packed partial table
+/// @param tableSize length of the partial table, in floats
+/// @param out where to put the non-zero bins
+/// @param capacity the most bins `out` can take
+/// @return the number of non-zero bins, or -1 if there are more than `capacity`.
+int find_sparse_partials(const float *partials, int tableSize, SparsePartial *out, int capacity);
+
+/// @brief Convert a run of polar partials to packed (re, im) pairs.
+/// @param amplitude `count` amplitudes
+/// @param phase `count` phases, in radians. Any value works; they don't need wrapping.
+/// @param out `count * 2` floats of output
+/// @param count number of partials
+void polar_to_cartesian(const float *amplitude, const float *phase, float *out, int count);
+
+/// @brief Editable partials, kept as separate amplitude and phase arrays.
+///
+/// This is the authoritative copy. Editors read and write it directly, without any trig, and
+/// the packed cartesian table the IFFT wants is rebuilt from it one changed range at a time.
+/// @tparam Bins number of bins. Bin 0 is DC.
+template <int Bins>
+struct PolarPartials {
+    static constexpr int bins = Bins;
+
+    std::array<float, Bins> amplitude;
+    std::array<float, Bins> phase;
+
+    /// @brief The bins changed since the last `take_dirty()`, as [dirtyBegin, dirtyEnd).
+    int dirtyBegin = 0, dirtyEnd = Bins;
+
+    /// @brief Set a single bin.
+    void set(int bin, float a, float p) {
+        amplitude[bin] = a;
+        phase[bin] = p;
+        touch(bin, bin + 1);
+    }
+
+    /// @brief Mark a range of bins as changed, after writing to `amplitude` or `phase` directly.
+    void touch(int begin, int end) {
+        dirtyBegin = std::min(dirtyBegin, begin);
+        dirtyEnd = std::max(dirtyEnd, end);
+    }
+
+    /// @brief Zero every bin.
+    void clear() {
+        amplitude.fill(0);
+        phase.fill(0);
+        touch(0, Bins);
+    }
+
+    /// @brief Get the changed range and reset it.
+    /// @return the range [begin, end) of bins changed since the last call. Empty if nothing changed.
+    std::pair<int, int> take_dirty() {
+        auto range = std::make_pair(dirtyBegin, dirtyEnd);
+        dirtyBegin = Bins;
+        dirtyEnd = 0;
+        return range;
+    }
+
+    /// @brief Rebuild a range of bins of a packed (`arm_rfft_fast_f32` layout) spectrum.
+    void to_cartesian(float *spectrum, int begin, int end) const {
+        if (begin >= end) return;
+        polar_to_cartesian(amplitude.data() + begin, phase.data() + begin, spectrum + begin * 2, end - begin);
+
+        // DC is real, and its imaginary slot holds the Nyquist bin, which we don't edit.
+        if (begin == 0) spectrum[1] = 0;
+    }
+};
+
+/// @brief Layout of a chain of band-limited copies ("mip levels") of a single-cycle table, stored end to end.
+///
+/// Level `m` holds partials up to `(TableSize / 2) >> m`, so it can be played back at up to 2^m times
+/// the table's fundamental without aliasing. Levels shrink by half until they reach `MinSize`.
+template <int TableSize, int MinSize, int Levels>
+struct MipChain {
+    static constexpr int table_size = TableSize;
+    static constexpr int levels = Levels;
+
+    /// @brief Length of the given level.
+    static constexpr int size(int level) { return std::max(TableSize >> level, MinSize); }
+
+    /// @brief log2 of the length of the given level.
+    static constexpr int size_bits(int level) {
+        int bits = 0;
+        while ((1 << bits) < size(level)) bits++;
+        return bits;
+    }
+
+    /// @brief Offset of the given level from the start of the chain.
+    static constexpr int offset(int level) { return level ? offset(level - 1) + size(level - 1) : 0; }
+
+    /// @brief Highest partial present in the given level. Only the first level keeps its Nyquist bin.
+    static constexpr int top_partial(int level) {
+        return level ? std::min((TableSize / 2) >> level, size(level) / 2) - 1 : TableSize / 2;
+    }
+
+    /// @brief Pick the first level that can be played `ratio` times faster than the fundamental.
+    static int level_for(float ratio) {
+        int level = 0;
+        while (level < Levels - 1 && (1 << level) < ratio) {
+            level++;
+        }
+        return level;
+    }
+
+    static constexpr int total_size = offset(Levels);
+};
+
+/// @brief What a `VoiceBank` plays: a morph between two mip tables, which may be fading in from older renders.
+struct VoiceSource {
+    const float *from, *to;         // the tables we're morphing between
+    float morph;                    // 0 for all `from`, 1 for all `to`
+    const float *fadeFrom, *fadeTo; // the same tables before their latest render
+    int fadeRemaining;              // samples left in the crossfade at the start of this block
+    int fadeLength;                 // total length of a crossfade
+};
+
+/// @brief A set of voices all playing the same mip-mapped single-cycle table, each at its own pitch
+/// and with its own linear attack/release envelope.
+/// @tparam NVoices how many voices can sound at once
+template <int NVoices>
+class VoiceBank {
+public:
+    static constexpr int size = NVoices;
+
+    struct Voice {
+        uint32_t phase = 0;     // playback position, 2^32 per cycle
+        uint32_t increment = 0; // phase increment per sample
+        int mipLevel = 0;       // band-limited level matching `increment`
+
+        float gain = 0;         // current envelope level
+        float target = 0;       // envelope level we're ramping toward
+        float step = 0;         // envelope change per sample
+        int rampRemaining = 0;  // samples until we reach `target`
+
+        int note = -1;          // who's playing this voice, for `stop()`
+        uint32_t started = 0;   // when the voice was started, for stealing
+
+        bool active() const { return gain > 0 || rampRemaining > 0; }
+
+        void rampTo(float level, int samples) {
+            target = level;
+            if (samples <= 0) {
+                gain = level;
+                rampRemaining = 0;
+                return;
+            }
+            step = (level - gain) / samples;
+            rampRemaining = samples;
+        }
+    };
+
+    /// @brief Envelope attack time, in samples.
+    int attackSamples = 64;
+
+    /// @brief Envelope release time, in samples.
+    int releaseSamples = 2048;
+
+protected:
+    std::array<Voice, NVoices> voices {};
+    uint32_t startCount = 0;
+
+public:
+    /// @brief Restart the voice already playing `note`, or start it on a free voice, or steal the
+    /// oldest one.
+    /// @return the voice index
+    int start(int note, uint32_t increment, int mipLevel, float amplitude) {
+        int chosen = -1;
+        for (int i = 0; i < NVoices && chosen < 0; i++) {
+            if (voices[i].note == note) chosen = i;
+        }
+
+        for (int i = 0; i < NVoices && chosen < 0; i++) {
+            if (!voices[i].active()) chosen = i;
+        }
+
+        if (chosen < 0) {
+            chosen = 0;
+            for (int i = 1; i < NVoices; i++) {
+                if (voices[i].started < voices[chosen].started) chosen = i;
+            }
+        }
+
+        Voice &v = voices[chosen];
+        v.increment = increment;
+        v.mipLevel = mipLevel;
+        v.note = note;
+        v.started = ++startCount;
+        v.rampTo(amplitude, attackSamples);
+
+        return chosen;
+    }
+
+    /// @brief Release every voice playing `note`.
+    void stop(int note) {
+        for (auto &v : voices) {
+            if (v.note == note && v.active()) {
+                v.rampTo(0, releaseSamples);
+                v.note = -1;
+            }
+        }
+    }
+
+    Voice &operator[](size_t i) { return voices[i]; }
+
+    /// @brief Resample and accumulate every active voice into `out` in one pass.
+    /// @param resampler the interpolation filters
+    /// @param source the tables to play
+    /// @param out `AUDIO_BLOCK_SAMPLES` of output, accumulated into
+    template <typename Mips, typename Resampler>
+    void render(Resampler const& resampler, VoiceSource const& source, float *out) {
+        const int fadeEnd = std::min(source.fadeRemaining, AUDIO_BLOCK_SAMPLES);
+        const float morph = source.morph;
+
+        for (auto &v : voices) {
+            if (!v.active()) continue;
+
+            const int bits = Mips::size_bits(v.mipLevel);
+            const int offset = Mips::offset(v.mipLevel);
+
+            uint32_t phase = v.phase;
+            float gain = v.gain;
+
+            // scanning costs one extra read and a lerp, and only when we're between frames.
+            auto read = [&](const float *from, const float *to) {
+                float s = resampler.read_cycle(from + offset, bits, phase);
+                if (morph != 0) {
+                    s += (resampler.read_cycle(to + offset, bits, phase) - s) * morph;
+                }
+                return s;
+            };
+
+            for (int i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+                float sample = read(source.from, source.to);
+                if (i < fadeEnd) {
+                    float t = (float) (source.fadeRemaining - i) / source.fadeLength;
+                    sample += (read(source.fadeFrom, source.fadeTo) - sample) * t;
+                }
+
+                out[i] += gain * sample;
+                phase += v.increment;
+
+                if (v.rampRemaining) {
+                    gain += v.step;
+                    if (!--v.rampRemaining) gain = v.target;
+                }
+            }
+
+            v.phase = phase;
+            v.gain = gain;
+        }
+    }
+};
+
+/// @brief Render a bank of rotating-phasor oscillators into `out`, matching the inverse `arm_rfft_fast_f32`.
+/// @param partials bins found by `find_sparse_partials()`
+/// @param count how many partials
+/// @param out the time-domain output
+/// @param tableSize length of `out`
+void render_sparse(const SparsePartial *partials, int count, float *out, int tableSize);
+
+/// @brief Grain envelope shapes.
+enum class GrainWindow : uint8_t {
+    hann,     // smooth in and out
+    triangle, // linear in and out
+    tukey,    // flat top with short cosine edges
+    decay,    // instant attack, exponential decay
+    count
+};
+
+/// @brief Precomputed grain envelopes, so a grain's window is a table lookup instead of trig.
+class GrainWindows {
+public:
+    /// @brief Table entries across one window.
+    static constexpr int size = 512;
+    static constexpr int shapes = (int) GrainWindow::count;
+
+private:
+    // one extra point per shape, so interpolation never reads past the end.
+    std::array<float, (size + 1) * shapes> table;
+
+public:
+    GrainWindows();
+
+    /// @brief Get the `size + 1` points of a window.
+    const float *shape(GrainWindow w) const { return &table[(int) w * (size + 1)]; }
+};
+
+/// @brief One grain: a windowed snippet of the source cycle, with its own pitch and pan.
+struct Grain {
+    uint32_t phase;         // read position in the source cycle
+    uint32_t increment;     // source phase per sample
+    int mipLevel;           // band limit for `increment`
+    float window;           // position in the window table
+    float windowStep;       // window table entries per sample
+    int remaining;          // samples left to play; 0 when the slot is free
+    int delay;              // samples to wait, in the next block, before starting
+    float gainLeft, gainRight;
+    GrainWindow shape;
+};
+
+/// @brief A fixed pool of grains, rendered together, that refuses new grains rather than overrun its CPU budget.
+/// @tparam NGrains hard cap on simultaneous grains
+template <int NGrains>
+class GrainCloud {
+    std::array<Grain, NGrains> grains {};
+    int active = 0;
+    uint32_t drops = 0;
+
+    /// @brief Smoothed render cost of one grain for one block.
+    float cyclesPerGrain = 0;
+
+public:
+    static constexpr int capacity = NGrains;
+
+    /// @brief Fraction of each audio block's CPU time grains may use.
+    float budget = 0.25f;
+
+    /// @brief Start a grain, unless we're at the cap or it'd blow the budget.
+    /// @return true if the grain was started.
+    bool spawn(Grain const& grain) {
+        int cap = capacity;
+        if (cyclesPerGrain > 0) {
+            const float blockCycles = F_CPU_ACTUAL * (AUDIO_BLOCK_SAMPLES / AUDIO_SAMPLE_RATE_EXACT);
+            cap = std::min(cap, (int) (blockCycles * budget / cyclesPerGrain));
+        }
+
+        if (active < cap) {
+            for (auto &g : grains) {
+                if (g.remaining) continue;
+                g = grain;
+                active++;
+                return true;
+            }
+        }
+
+        drops++;
+        return false;
+    }
+
+    /// @brief Number of grains playing.
+    int playing() const { return active; }
+
+    /// @brief Number of grains refused since startup.
+    uint32_t dropped() const { return drops; }
+
+    /// @brief Render every active grain and accumulate it into the outputs.
+    /// @param resampler the interpolation filters
+    /// @param windows the window table
+    /// @param source the tables to read grains from, morphed like the voices'. Crossfades are ignored.
+    /// @param left `AUDIO_BLOCK_SAMPLES` of left output, accumulated into
+    /// @param right `AUDIO_BLOCK_SAMPLES` of right output, accumulated into
+    template <typename Mips, typename Resampler>
+    void render(Resampler const& resampler, GrainWindows const& windows, VoiceSource const& source, float *left, float *right) {
+        if (!active) return;
+
+        const uint32_t startCycles = ARM_DWT_CYCCNT;
+        int rendered = 0;
+
+        const float morph = source.morph;
+        float gathered[AUDIO_BLOCK_SAMPLES];
+
+        for (auto &g : grains) {
+            if (!g.remaining) continue;
+
+            const int first = g.delay;
+            const int n = std::min(AUDIO_BLOCK_SAMPLES - first, g.remaining);
+            g.delay = 0;
+
+            // gather the source first, so the window and pan loop is a straight run of multiply-adds.
+            const int bits = Mips::size_bits(g.mipLevel);
+            const float *from = source.from + Mips::offset(g.mipLevel);
+            const float *to = source.to + Mips::offset(g.mipLevel);
+            uint32_t phase = g.phase;
+            for (int i = 0; i < n; i++) {
+                float s = resampler.read_cycle(from, bits, phase);
+                if (morph != 0) {
+                    s += (resampler.read_cycle(to, bits, phase) - s) * morph;
+                }
+                gathered[i] = s;
+                phase += g.increment;
+            }
+            g.phase = phase;
+
+            const float *w = windows.shape(g.shape);
+            float pos = g.window;
+            for (int i = 0; i < n; i++) {
+                const int index = (int) pos;
+                const float env = w[index] + (w[index + 1] - w[index]) * (pos - index);
+                const float s = gathered[i] * env;
+                left[first + i] += s * g.gainLeft;
+                right[first + i] += s * g.gainRight;
+                pos += g.windowStep;
+            }
+            g.window = pos;
+
+            g.remaining -= n;
+            if (!g.remaining) active--;
+            rendered++;
+        }
+
+        const float cost = (float) (ARM_DWT_CYCCNT - startCycles) / rendered;
+        cyclesPerGrain = cyclesPerGrain > 0 ? cyclesPerGrain + (cost - cyclesPerGrain) * 0.1f : cost;
+    }
+};
+
+}
+
+class AudioSynthAdditive;
+
 
 struct GrainEvent : public TimerEventInterface {
     AudioSynthAdditive *synth;
@@ -28,68 +471,243 @@ struct GrainEvent : public TimerEventInterface {
     virtual void execute() override;
 };
 
+/// @brief Most grain events `AudioSynthAdditive` can have scheduled at once.
+#ifndef ADDITIVE_GRAIN_EVENTS
+#define ADDITIVE_GRAIN_EVENTS 10
+#endif
+
+/// @brief Most grains `AudioSynthAdditive` will play at once, however dense the cloud.
+#ifndef ADDITIVE_GRAINS
+#define ADDITIVE_GRAINS 32
+#endif
+
+/// @brief Phases in the additive playback filter bank. More phases means less interpolation noise.
+#ifndef ADDITIVE_RESAMPLER_PHASES
+#define ADDITIVE_RESAMPLER_PHASES 64
+#endif
+
+/// @brief Taps in the additive playback filter bank. More taps means a flatter passband.
+#ifndef ADDITIVE_RESAMPLER_TAPS
+#define ADDITIVE_RESAMPLER_TAPS 8
+#endif
+
+/// @brief Frames in the `AudioSynthAdditive` wavetable. Each costs about 64 KB: 16 KB of partials,
+/// 16 KB of spectrum and 32 KB of rendered mip table. One more table is kept to render into, so 8
+/// frames come to about 550 KB.
+#ifndef ADDITIVE_FRAMES
+#define ADDITIVE_FRAMES 8
+#endif
+
+/// @brief Keep the wavetable in PSRAM. By default, only when it's too big to share RAM2 with everything else.
+/// Without PSRAM the allocation fails, and the synth stays silent; see `partials()`.
+#ifndef ADDITIVE_FRAMES_IN_EXTMEM
+#define ADDITIVE_FRAMES_IN_EXTMEM (ADDITIVE_FRAMES > 4)
+#endif
+
+/// @brief How many notes `AudioSynthAdditive` can play at once.
+#ifndef ADDITIVE_VOICES
+#define ADDITIVE_VOICES 8
+#endif
+
+/// @brief Spectral wavetable synth with a grain cloud. Output 0 is left (or mono), output 1 is right;
+/// only the grains are panned.
 class AudioSynthAdditive : public AudioStream {
-public:
 private:
-    /// @brief If this is throwing up problems, you've set the `partial_table_size` to an unsupported value.
-    template<bool flag = false> void static_no_match() { static_assert(flag, "FFT size not supported."); }
-
     TimerWheel grainScheduler {};
 
+    /// @brief Preallocated grain events, so scheduling never touches the heap.
+    EventPool<GrainEvent, ADDITIVE_GRAIN_EVENTS> grainEvents;
+
 public:
     static constexpr auto partial_table_size = 4096;
     static constexpr auto signal_table_size = partial_table_size;
     static constexpr float fundamental_frequency = AUDIO_SAMPLE_RATE_EXACT / signal_table_size;
 
-    std::array<float, partial_table_size> partialTable; // frequency domain, packed amplitude and phase
-    std::array<float, signal_table_size> signal; // time domain, amplitude
+    /// @brief How long to crossfade from the old signal to a freshly rendered one.
+    static constexpr auto crossfade_samples = AUDIO_BLOCK_SAMPLES;
 
-    arm_rfft_fast_instance_f32 fftInstance;
+    /// @brief Band-limited copies of the signal. The smallest level is limited by the smallest rfft.
+    using Mips = additive::MipChain<signal_table_size, 32, 11>;
 
-    /// @brief Phase tracker for spectral mode.
-    int rawPlaybackPhase = 0;
-    
-    bool doDebug = false;
+    static constexpr auto mip_levels = Mips::levels;
+
+    /// @brief The single-cycle signal, followed by each band-limited mip level.
+    using MipTable = std::array<float, Mips::total_size>;
+
+    using Resampler = resample::PolyphaseBank<ADDITIVE_RESAMPLER_PHASES, ADDITIVE_RESAMPLER_TAPS>;
+
+    /// @brief Frequency domain, packed real and imaginary parts in `arm_rfft_fast_f32` layout.
+    using Spectrum = std::array<float, partial_table_size>;
+
+    /// @brief The editable form of a spectrum, one amplitude and phase per bin.
+    using Partials = additive::PolarPartials<partial_table_size / 2>;
+
+    static constexpr auto n_frames = ADDITIVE_FRAMES;
+
+    /// @brief Backing store for the wavetable. Big, so it's allocated once, wherever it fits.
+    struct Wavetable {
+        /// @brief The editable partials for each frame.
+        std::array<Partials, n_frames> partials;
+
+        /// @brief The partials for each frame converted for the IFFT, kept up to date by `service()`.
+        std::array<Spectrum, n_frames> spectra;
+
+        /// @brief A rendered table for each frame, plus one spare to render into.
+        std::array<MipTable, n_frames + 1> tables;
+    };
+
+protected:
+    Wavetable *wavetable = nullptr;
+
+    /// @brief The rendered table playing for each frame. Only the audio thread changes these.
+    std::array<MipTable*, n_frames> frames {};
+
+    /// @brief A table that's free for `service()` to render into, or null if it's in use.
+    MipTable *volatile spare = nullptr;
+
+    /// @brief A frame `service()` has finished rendering, waiting for the audio thread to swap it in.
+    volatile int pendingFrame = -1;
+    MipTable *pendingTable = nullptr;
+
+    /// @brief The frame we're crossfading into a new render, and its old table.
+    int fadingFrame = -1;
+    MipTable *fadingTable = nullptr;
+
+    /// @brief Samples left in the current crossfade.
+    int crossfadeRemaining = 0;
+
+    /// @brief Bumped every time a frame's partials are changed.
+    std::array<volatile uint32_t, n_frames> frameGeneration {};
+
+    /// @brief The `frameGeneration` currently rendered for each frame.
+    std::array<uint32_t, n_frames> renderedGeneration {};
 
-    int grainsOut = 0;
+    /// @brief The frame `partials()` refers to.
+    int editing = 0;
+
+    /// @brief Scan position through the frames, from 0 to `n_frames - 1`.
+    float scanPosition = 0;
+
+    /// @brief Scratch for the IFFT, which destroys its input.
+    Spectrum fftWorkspace;
+
+    /// @brief One rfft per mip level.
+    std::array<arm_rfft_fast_instance_f32, mip_levels> fftInstances;
+
+    /// @brief Most non-zero partials the oscillator kernel can ever handle.
+    static constexpr auto sparse_capacity = 64;
+
+    /// @brief Scratch for the oscillator kernel.
+    std::array<additive::SparsePartial, sparse_capacity> sparsePartials;
+
+    /// @brief Use the oscillator kernel at or below this many partials.
+    int sparseLimit = std::min(ADDITIVE_SPARSE_CROSSOVER, sparse_capacity);
+
+    /// @brief Render every mip level of a spectrum with whichever kernel is cheaper.
+    void renderFrame(Spectrum const& partials, MipTable &out);
+
+    /// @brief Shared interpolation filters for playback.
+    static const Resampler resampler;
+
+    /// @brief The voices, all playing the same scan through the frames.
+    additive::VoiceBank<ADDITIVE_VOICES> voices;
 
 public:
+    /// @brief Settings for the grain cloud.
+    struct GrainParams {
+        float density = 0;              // grains per second, on average. 0 stops the cloud.
+        float durationMs = 60;
+        float ratio = 1;                // pitch, relative to the last note played
+        float ratioSpread = 0;          // random pitch variation, in octaves either way
+        float offset = 0;               // start position in the cycle, 0-1
+        float offsetSpread = 1;         // random variation in start position, 0-1
+        float panSpread = 0;            // random pan, 0 for center to 1 for hard left or right
+        float amplitude = 0.25f;
+        additive::GrainWindow window = additive::GrainWindow::hann;
+    };
 
-    AudioSynthAdditive(void) : AudioStream(0, nullptr) {
-        // The larger FFT tables get really big. By making this `if constexpr`, it ensures
-        // we only ever reference the right-sized function. This means we only pull in the
-        // tables we actually need.
-        if constexpr (partial_table_size == 256) {
-            arm_rfft_fast_init_256_f32(&fftInstance);
-        }
-        else if constexpr (partial_table_size == 1024) {
-            arm_rfft_fast_init_1024_f32(&fftInstance);
-        }
-        else if constexpr (partial_table_size == 2048) {
-            arm_rfft_fast_init_2048_f32(&fftInstance);
-        }
-        else if constexpr (partial_table_size == 4096) {
-            arm_rfft_fast_init_4096_f32(&fftInstance);
-        }
-        else {
-            static_no_match();
-        }
-    }
+protected:
+    GrainParams grainParams;
+
+    /// @brief The grains get their pitch from the most recent note.
+    float grainFrequency = 220;
+
+    additive::GrainCloud<ADDITIVE_GRAINS> grainCloud;
+
+    /// @brief Shared envelope tables for the grains.
+    static const additive::GrainWindows grainWindows;
+
+    /// @brief Samples until the next grain, drawn around the mean spacing for the density.
+    Tick nextGrainDelay();
+
+public:
+    bool doDebug = false;
+
+public:
+
+    AudioSynthAdditive(void);
 
     void scheduleGrain();
-    void reapGrain() { if (--grainsOut < 0) grainsOut = 0; }
 
-    /// @brief Get a reference to the partial array.
-    /// @return A mutable reference to the partial array.
-    std::array<float, partial_table_size>& partials() { return partialTable; }
+    /// @brief Start a grain for an event that's come due, and schedule the next one.
+    void grainFired(GrainEvent *event);
+
+    /// @brief Get the grain event pool, for its usage counters.
+    auto const& grainPool() const { return grainEvents; }
+
+    /// @brief Get the partials being edited. Call `partialsChanged()` after writing to them.
+    /// @return the partials, or nullptr if there was no memory for the wavetable.
+    Partials* partials() { return partials(editing); }
+
+    /// @brief Get the given frame's partials. Call `partialsChanged()` after writing to them.
+    /// @return the partials, or nullptr if there was no memory for the wavetable.
+    Partials* partials(int frame) { return wavetable ? &wavetable->partials[frame] : nullptr; }
+
+    /// @brief Let the synth know a frame's partials have changed, so `service()` will render it again.
+    void partialsChanged(int frame) { frameGeneration[frame] = frameGeneration[frame] + 1; }
+
+    /// @brief Let the synth know the frame being edited has changed.
+    void partialsChanged() { partialsChanged(editing); }
+
+    /// @brief Choose which frame `partials()` refers to.
+    void editFrame(int frame) { editing = std::max(0, std::min(frame, (int) n_frames - 1)); }
+
+    /// @brief Set the scan position through the frames. Fractional positions morph between neighbors.
+    void scan(float position) { scanPosition = std::max(0.f, std::min(position, (float) n_frames - 1)); }
+
+    /// @brief Get the full-resolution signal currently playing for the frame being edited.
+    /// @return `signal_table_size` samples of one cycle, or nullptr if there was no memory for the wavetable.
+    float* samples() { return frames[editing] ? frames[editing]->data() : nullptr; }
 
-    /// @brief Get a reference to the signal array.
-    /// @return A mutable reference to the signal array.
-    std::array<float, signal_table_size>& samples() { return signal; }
+    /// @brief Render any frames whose partials have changed. Call this from `loop()`, never from an interrupt.
+    void service();
 
     void debug(bool debug) { doDebug = debug; }
 
-    /// @brief Clear the whole partial table back to 0.
+    /// @brief Set the partial count at which we switch from oscillators to the IFFT.
+    void sparseCrossover(int partials) { sparseLimit = std::max(0, std::min(partials, (int) sparse_capacity)); }
+
+    /// @brief Start playing a note.
+    /// @param note the note number, used to find the voice again in `noteOff()`
+    /// @param f the frequency of one cycle of the signal, in Hz
+    /// @param amplitude peak level, 0-1
+    void noteOn(int note, float f, float amplitude);
+
+    /// @brief Release the given note.
+    void noteOff(int note);
+
+    /// @brief Set the envelope times for subsequent notes.
+    /// @param attackMs time to reach full amplitude
+    /// @param releaseMs time to fall to zero after `noteOff()`
+    void envelope(float attackMs, float releaseMs);
+
+    /// @brief Change the grain cloud settings.
+    void grains(GrainParams const& params);
+
+    /// @brief Get the grain cloud, for its counters.
+    auto const& grainStats() const { return grainCloud; }
+
+    /// @brief Clear the partial table being edited back to 0.
     void clearPartials();
 
     virtual void update(void) override;
@@ -109,64 +727,55 @@ struct ControlPoint {
   float& operator[](size_t i) { return a[i]; }
 };
 
-// A class to perform high-frequency interpolation between control points
-template <int N, int M> // a template parameter for the size of the amplitude array, and the number of points in the sequence
-class HighFrequencyInterpolator {
-  private:
-    float delta_a[4][N]; // a static array of delta-a values for each span and each amplitude
-    int offset[4]; // a static array of sample step offsets for each span
-    int span; // the current span index
-    int step; // the current step index
-  public:
-    // A constructor that takes a buffer of control points and a sample rate and computes the delta-a and offset arrays
-    void load(ControlPoint<N>* buffer, int sample_rate) {
-      // loop through the control points and compute the delta-a and offset values
-      for (int i = 0; i < (M - 1); i++) {
-        // loop through the N amplitudes and compute the delta-a for each one
-        for (int j = 0; j < N; j++) {
-          // delta-a is the change in amplitude divided by the number of steps in the span
-          delta_a[i][j] = (buffer[i+1].a[j] - buffer[i].a[j]) / (buffer[i+1].t - buffer[i].t);
-        }
-        // offset is the difference between the sample time index and the actual time index of the control point
-        offset[i] = buffer[i].t - i * sample_rate;
-      }
-      // initialize the span and step values
-      span = 0;
-      step = 0;
+// Where one voice is in a SequenceInterpolator. The control points themselves live in the
+// interpolator and are shared, so a cursor costs the same however many points there are.
+template <int N> // the length of the amplitude array
+struct SequenceCursor {
+    int index = 0;      // the current index of the point
+    int t = 0;          // the current time
+    int zeroTarget = 0;
+    float lastVals[N] {};
+    float a[N] {};      // the current amplitude array
+
+    /// @brief Start again from the first control point.
+    void restart() {
+        index = 0;
+        t = 0;
+        zeroTarget = 0;
     }
 
-    // A method that returns the next delta-a vector
-    float* next() {
-      // if the span index is out of bounds, return a zero vector
-      if (span >= 4) {
-        static float zero[N] = {0}; // a static zero vector
-        return zero;
-      }
-      // if the step index is equal to the offset, increment the span and reset the step
-      if (step == offset[span]) {
-        span++;
-        step = 0;
-      }
-      // increment the step and return the delta-a vector
-      step++;
-      return delta_a[span];
+    /// @brief Has `zero()` been called since the last `restart()`?
+    bool released() const { return zeroTarget; }
+
+    /// @brief Has a `zero()` run all the way down?
+    bool finished() const { return zeroTarget && t > zeroTarget; }
+
+    /// interpolate from current position to zero.
+    /// @param ticks how many ticks to reach zero?
+    void zero(int ticks) {
+        if (zeroTarget) {
+            return; // already going to zero
+        }
+        std::copy(a, a + N, lastVals);
+        zeroTarget = ticks;
+        t = 0;
     }
 };
 
-// A class to perform linear interpolation between control points
+// A class to perform linear interpolation between control points. It has a cursor of its own,
+// and can step any other cursor through the same points.
 template <int N, int M> // the length of the amplitude array
-class SequenceInterpolator {
+class SequenceInterpolator : public SequenceCursor<N> {
   private:
     static const ControlPoint<N> ZeroPoint;
 
     std::array<ControlPoint<N>, M> points{}; // the list of control points
-    int index = 0;                           // the current index of the point
-    int t = 0;                               // the current time
-    int zeroTarget = 0;
-    float lastVals[N];
 
   public:
-    float a[N]; // the current amplitude array
+    using Cursor = SequenceCursor<N>;
+
+    static constexpr int n_values = N; // amplitudes per control point
+    static constexpr int n_points = M; // control points
 
     SequenceInterpolator() {
         for (int i = 0; i < M; i++) {
@@ -175,36 +784,29 @@ class SequenceInterpolator {
         }
     }
 
-    /// interpolate from current position to zero.
-    /// @param ticks how many ticks to reach zero?
-    void zero(int ticks) {
-        if (zeroTarget) {
-            return; // already going to zero
-        }
-        std::copy(a, a + N, lastVals);
-        zeroTarget = ticks;
-        t = 0;
-    }
-
     // Returns the next interpolated amplitude array
-    float *next() {
-        ControlPoint<N> &p1 = points[index];
+    float *next() { return next(*this); }
 
-        if (zeroTarget) {
-            if (t > zeroTarget) {
+    // Steps a cursor and returns its next interpolated amplitude array
+    float *next(Cursor &c) const {
+        float *a = c.a;
+        const ControlPoint<N> &p1 = points[c.index];
+
+        if (c.zeroTarget) {
+            if (c.t > c.zeroTarget) {
                 return a;
             }
 
-            float tZero = (float) t / zeroTarget;
+            float tZero = (float) c.t / c.zeroTarget;
             for (int i = 0; i < N; i++) {
-                a[i] = lastVals[i] + (ZeroPoint.a[i] - lastVals.a[i]) * tZero;
+                a[i] = c.lastVals[i] + (ZeroPoint.a[i] - c.lastVals[i]) * tZero;
             }
 
-            t++;
+            c.t++;
             return a;
         }
 
-        ControlPoint<N> &p2 = points[(index + 1) % points.size()];
+        const ControlPoint<N> &p2 = points[(c.index + 1) % points.size()];
 
         // zero-to-negative values mean "stay here"
         if (p1.t <= 0) {
@@ -214,42 +816,161 @@ class SequenceInterpolator {
             return a;            
         }
 
-        if (t >= p1.t) {
-            t = 0;
-            index = (index + 1) % points.size();
+        if (c.t >= p1.t) {
+            c.t = 0;
+            c.index = (c.index + 1) % points.size();
             for (int i = 0; i < N; i++) {
                 a[i] = p2.a[i];
             }
             return a;
         }
 
-        float tPt = (float) t / p1.t;
+        float tPt = (float) c.t / p1.t;
         for (int i = 0; i < N; i++) {
             a[i] = p1.a[i] + (p2.a[i] - p1.a[i]) * tPt;
         }
 
         // Increment the current time by 1
-        t++;
+        c.t++;
 
         // Return the interpolated amplitude array
         return a;
     }
 
+    /// @brief `span()` on this interpolator's own cursor.
+    int span(int maxSamples, float *start, float *step) { return span(*this, maxSamples, start, step); }
+
+    /// @brief Advance a cursor along one straight piece of the envelope, instead of calling `next()` a sample at a time.
+    ///
+    /// Sample `k` of the piece is `start[i] + step[i] * k`, which is what `next()` would have returned
+    /// to within float rounding. The cursor's `a` ends up holding the piece's last sample, as if `next()` had been called.
+    /// @param c the cursor to advance
+    /// @param maxSamples the most samples to cover, at least 1
+    /// @param start filled with the first sample's values
+    /// @param step filled with the change per sample
+    /// @return how many samples the piece covers, from 1 to `maxSamples`.
+    int span(Cursor &c, int maxSamples, float *start, float *step) const {
+        if (c.zeroTarget) {
+            if (c.t > c.zeroTarget) {
+                return hold(c, maxSamples, c.a, start, step);
+            }
+
+            const int length = std::min(maxSamples, c.zeroTarget - c.t + 1);
+            const float tZero = (float) c.t / c.zeroTarget;
+            for (int i = 0; i < N; i++) {
+                start[i] = c.lastVals[i] + (ZeroPoint.a[i] - c.lastVals[i]) * tZero;
+                step[i] = (ZeroPoint.a[i] - c.lastVals[i]) / c.zeroTarget;
+            }
+
+            c.t += length;
+            if (c.t > c.zeroTarget) {
+                std::copy(ZeroPoint.a, ZeroPoint.a + N, c.a); // land exactly on zero, as `next()` does
+            }
+            else {
+                settle(c, length, start, step);
+            }
+            return length;
+        }
+
+        const ControlPoint<N> &p1 = points[c.index];
+        const ControlPoint<N> &p2 = points[(c.index + 1) % points.size()];
+
+        if (p1.t <= 0) {
+            return hold(c, maxSamples, p1.a, start, step);
+        }
+
+        // moving on to the next point takes a sample of its own.
+        if (c.t >= p1.t) {
+            c.t = 0;
+            c.index = (c.index + 1) % points.size();
+            return hold(c, 1, p2.a, start, step);
+        }
+
+        const int length = std::min(maxSamples, p1.t - c.t);
+        const float tPt = (float) c.t / p1.t;
+        for (int i = 0; i < N; i++) {
+            start[i] = p1.a[i] + (p2.a[i] - p1.a[i]) * tPt;
+            step[i] = (p2.a[i] - p1.a[i]) / p1.t;
+        }
+
+        c.t += length;
+        settle(c, length, start, step);
+        return length;
+    }
+
+    /// @brief Advance several cursors along their current pieces in one pass, so the control points
+    /// stay in cache across them.
+    /// @param cursors the cursors
+    /// @param remaining how many samples each cursor may cover. Cursors with 0 are skipped.
+    /// @param count number of cursors
+    /// @param start filled with `N` start values per cursor, one cursor after another
+    /// @param step filled with `N` steps per cursor, laid out like `start`
+    /// @param lengths filled with how many samples each cursor's piece covers, 0 for skipped cursors
+    void spans(Cursor *cursors, const int *remaining, int count, float *start, float *step, int *lengths) const {
+        for (int i = 0; i < count; i++) {
+            lengths[i] = remaining[i] > 0 ? span(cursors[i], remaining[i], start + i * N, step + i * N) : 0;
+        }
+    }
+
     ControlPoint<N> &operator[](size_t i) { return points[i]; }
+    const ControlPoint<N> &operator[](size_t i) const { return points[i]; }
+
+  private:
+    static int hold(Cursor &c, int samples, const float *values, float *start, float *step) {
+        if (values != c.a) std::copy(values, values + N, c.a);
+        std::copy(values, values + N, start);
+        std::fill(step, step + N, 0.f);
+        return samples;
+    }
+
+    static void settle(Cursor &c, int length, const float *start, const float *step) {
+        for (int i = 0; i < N; i++) {
+            c.a[i] = start[i] + step[i] * (length - 1);
+        }
+    }
 };
 
 template <int N, int M>
 const ControlPoint<N> SequenceInterpolator<N, M>::ZeroPoint {};
 
-class AudioSynthOscBank : public AudioStream {
+namespace oscbank {
+
+/// @brief The original sample-at-a-time kernel, using the fixed-point `taylor()`, with the envelope
+/// given per sample: `AUDIO_BLOCK_SAMPLES` amplitudes and phase offsets for each harmonic, one
+/// harmonic after another. Kept as the reference for accuracy and speed comparisons.
+void render_reference(const uint32_t *phases, const uint32_t *increments, const float *amplitude, const uint32_t *offset, int count, float *out);
+
+}
+
+/// @brief Four banks of sine oscillators, one note each, sharing a voice envelope.
+/// @tparam Harmonics partials per bank: 16, 32 or 64
+/// @tparam Sine the sine kernel: `oscbank::Taylor`, `Minimax`, `Table` or `Rotator`
+template <int Harmonics, typename Sine = oscbank::Taylor>
+class AudioSynthOscBankN : public AudioStream {
+    static_assert(Harmonics == 16 || Harmonics == 32 || Harmonics == 64, "Banks have 16, 32 or 64 harmonics.");
+
 public:
     static constexpr auto nBanks = 4;
-    static constexpr auto bankSize = 16;
+    static constexpr auto bankSize = Harmonics;
     static constexpr auto nControlPoints = 5;
 
+    using Envelope = SequenceInterpolator<bankSize * 2, nControlPoints>;
+
+    /// @brief Everything about the voice that's shared by the banks.
     struct VoicePrototype {
-        std::array<float, bankSize> amplitudes {};
-        std::array<uint32_t, bankSize> phaseOffsets {};
+        /// @brief The envelope's control points: each partial's amplitude, then each partial's phase offset.
+        Envelope envelope {};
+
+        /// @brief Each partial's frequency as a multiple of the fundamental. Ascending.
+        std::array<float, bankSize> ratios {};
+    };
+
+    /// @brief Which bank to take over when a note arrives and every bank is busy. Banks that are
+    /// already releasing are always taken first.
+    enum class Stealing {
+        roundRobin, // the next bank in turn
+        oldest,     // the bank that started longest ago
+        quietest    // the bank with the lowest total amplitude right now
     };
 
 protected:
@@ -260,53 +981,139 @@ protected:
         int cutoff = 0;
         bool active = false;
 
-        void update();
-        float sample();
+        /// @brief Set when the pitch or ratios change, so `tune()` runs at the next block and not before.
+        bool retune = true;
+
+        int note = -1;
+        uint32_t startedAt = 0;
+
+        /// @brief Move every harmonic's phase forward.
+        void advance(int samples);
+
+        /// @brief Change the fundamental, from the next block.
         void frequency(float f);
 
+        /// @brief Work out the phase increments and the Nyquist cutoff for the current fundamental.
+        /// @param ratios each partial's multiple of the fundamental
+        void tune(const float *ratios);
+
         Bank() {
             std::fill(accumulators.begin(), accumulators.end(), 0);
             std::fill(phaseIncrements.begin(), phaseIncrements.end(), 0);
         }
     };
 
-    /// @brief Sample the given bank.
-    /// @param b reference to the bank to sample
-    /// @return denormalized floating point signal
-    float sample(Bank &b);
+    /// @brief Each bank's place in the voice envelope, so notes attack and release independently.
+    /// Kept together, apart from the banks, so they're stepped in one pass.
+    std::array<typename Envelope::Cursor, nBanks> envelopes {};
+
+    /// @brief Each bank's current piece of envelope: amplitudes then phase offsets, as laid out in `Envelope`.
+    std::array<float, nBanks * bankSize * 2> envelopeStart {};
+    std::array<float, nBanks * bankSize * 2> envelopeStep {};
+
+    /// @brief Sum of a bank's current harmonic amplitudes.
+    float level(int bank) const;
 
     /// @brief The oscillator banks.
     std::array<Bank, nBanks> banks {};
 
-    /// @brief The voice profile we're playing.
-    VoicePrototype voice {};
+    /// @brief The voice as edited. Only touched outside the audio interrupt, so reading it is always safe there.
+    VoicePrototype editing {};
+
+    /// @brief Set when `editing` has changed since it was last published.
+    bool editingChanged = false;
+
+    /// @brief The copies the audio interrupt plays from: `live`, and a spare `service()` publishes into.
+    std::array<VoicePrototype, 2> voices {};
+
+    /// @brief The voice every bank is playing. Only the audio thread changes this.
+    VoicePrototype *live = &voices[0];
 
-    SequenceInterpolator<bankSize * 2, nControlPoints> voiceInterpolator {};
+    /// @brief A voice `service()` has published, waiting for the audio thread to swap it in at a block boundary.
+    VoicePrototype *volatile pending = nullptr;
+
+    Stealing stealPolicy = Stealing::roundRobin;
+
+    /// @brief Where round-robin allocation looks next.
+    int nextBank = 0;
+
+    /// @brief Counts notes, to find the oldest.
+    uint32_t noteCounter = 0;
+
+    /// @brief How long released notes take to fade out.
+    int releaseSamples = AUDIO_SAMPLE_RATE_EXACT * 0.05f;
+
+    /// @brief Pick a bank for a new note, stealing one if need be.
+    int allocateBank(int note);
 
     bool _debug = false;
 
 public:
-    AudioSynthOscBank(void) : AudioStream(0, NULL) { 
+    AudioSynthOscBankN(void) : AudioStream(0, NULL) { 
         for (int i = 0; i < nBanks; i++) {
             frequency(i, 440);
         }
 
-        voice.amplitudes[0] = 0.5f;
+        partialRatios(nullptr);
+        voices[0] = voices[1] = editing;
+        editingChanged = false;
     }
 
     void frequency(int bank, float f);
 
     void setActive(int bank, bool active) { banks[bank].active = active; }
 
+    /// @brief Start a note on a free bank, or steal one.
+    /// @param note the note number, used to find the bank again in `noteOff()`
+    /// @param f the fundamental frequency
+    void noteOn(int note, float f);
+
+    /// @brief Release the given note. It fades out over the release time, then its bank goes idle.
+    void noteOff(int note);
+
+    /// @brief Choose how banks are stolen when all four are busy.
+    void stealing(Stealing policy) { stealPolicy = policy; }
+
+    /// @brief Give the partials their own frequency ratios, for stretched or bell-like spectra.
+    /// Partials are cut off from the first one above Nyquist, so the ratios should ascend.
+    /// Takes effect once `service()` publishes it.
+    /// @param ratios `bankSize` multiples of the fundamental, or null for the harmonic series
+    void partialRatios(const float *ratios);
+
+    /// @brief Set the release time for subsequent `noteOff()`s.
+    void releaseTime(float ms) { releaseSamples = std::max(1.f, ms * (AUDIO_SAMPLE_RATE_EXACT / 1000.f)); }
+
     void debug(bool d) { _debug = d; }
 
-    decltype(voiceInterpolator)& getVoice() { return voiceInterpolator; }
+    /// @brief Get the voice envelope for editing. Call `voiceChanged()` after writing to it.
+    Envelope& getVoice() { return editing.envelope; }
+
+    /// @brief Let the synth know the voice has been edited, so `service()` will publish it.
+    void voiceChanged() { editingChanged = true; }
 
-    void previewVoice(float *out, int nSamples);
+    /// @brief Hand the edited voice to the audio thread, if it's changed and the last one has been
+    /// taken. Call this from `loop()`, never from an interrupt.
+    void service();
+
+    /// @brief Render one control point of the edited voice, held, as one cycle of the fundamental.
+    /// @param out where to put the samples
+    /// @param nSamples the cycle length
+    /// @param point the control point
+    void previewVoice(float *out, int nSamples, int point = 0);
 
     virtual void update(void) override;
 };
 
+#ifndef OSCBANK_HARMONICS
+#define OSCBANK_HARMONICS 16
+#endif
+
+#ifndef OSCBANK_SINE
+#define OSCBANK_SINE oscbank::Taylor
+#endif
+
+using AudioSynthOscBank = AudioSynthOscBankN<OSCBANK_HARMONICS, OSCBANK_SINE>;
+
 
 // class AudioSynthIFFTBank : public AudioStream {
 // public:
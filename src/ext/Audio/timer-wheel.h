@@ -87,6 +87,7 @@
 #ifndef RATAS_TIMER_WHEEL_H
 #define RATAS_TIMER_WHEEL_H
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstdint>
@@ -229,6 +230,20 @@ public:
                         size_t max_execute=std::numeric_limits<size_t>::max(),
                         int level = 0);
 
+    // Advance the TimerWheel by a whole block of ticks (e.g. one audio
+    // block of samples), executing any events due inside it. This is
+    // equivalent to calling advance(1) delta times, but ticks that can't
+    // have any work on them are skipped outright, so a block with no due
+    // events costs a couple of comparisons.
+    //
+    // During an event callback, block_offset() gives the event's position
+    // within the block, from 0 to delta - 1.
+    inline void advance_block(Tick delta);
+
+    // The offset of the executing event within the current advance_block()
+    // call. Only meaningful inside an event callback.
+    Tick block_offset() const { return now_[0] - block_start_ - 1; }
+
     // Schedule the event to be executed delta ticks from the current time.
     // The delta must be non-0.
     inline void schedule(TimerEventInterface* event, Tick delta);
@@ -280,6 +295,11 @@ private:
     // We've done a partial tick advance. This is how many ticks remain
     // unprocessed.
     Tick ticks_pending_;
+    // No event is due before this tick. Kept conservative: it may be
+    // earlier than the real next event (e.g. after a cancel), never later.
+    Tick earliest_ = std::numeric_limits<Tick>::max();
+    // The tick the current advance_block() call started from.
+    Tick block_start_ = 0;
     TimerWheelSlot slots_[NUM_LEVELS][NUM_SLOTS];
 };
 
@@ -373,6 +393,39 @@ bool TimerWheel::advance(Tick delta, size_t max_events, int level) {
     return true;
 }
 
+void TimerWheel::advance_block(Tick delta) {
+    block_start_ = now_[0];
+
+    while (delta) {
+        // Only two kinds of tick need real work: ones an event might be
+        // due on, and ones where the core wheel wraps and promotes
+        // events from the outer wheels. Everything before them is
+        // empty, so just move the clock.
+        Tick to_wrap = NUM_SLOTS - (now_[0] & MASK);
+        Tick to_due = earliest_ > now_[0] ? earliest_ - now_[0] : 1;
+        Tick quiet = std::min(to_wrap, to_due) - 1;
+
+        if (delta <= quiet) {
+            now_[0] += delta;
+            return;
+        }
+
+        now_[0] += quiet;
+        delta -= quiet + 1;
+
+        advance(1);
+
+        // Find the next event only once we've reached the last one.
+        if (earliest_ <= now_[0]) {
+            earliest_ = std::numeric_limits<Tick>::max();
+            Tick next = ticks_to_next_event();
+            if (next != std::numeric_limits<Tick>::max()) {
+                earliest_ = now_[0] + next;
+            }
+        }
+    }
+}
+
 bool TimerWheel::process_current_slot(Tick now, size_t max_events, int level) {
     size_t slot_index = now & MASK;
     auto slot = &slots_[level][slot_index];
@@ -414,6 +467,7 @@ bool TimerWheel::process_current_slot(Tick now, size_t max_events, int level) {
 void TimerWheel::schedule(TimerEventInterface* event, Tick delta) {
     assert(delta > 0);
     event->set_scheduled_at(now_[0] + delta);
+    earliest_ = std::min(earliest_, now_[0] + delta);
 
     int level = 0;
     while (delta >= NUM_SLOTS) {
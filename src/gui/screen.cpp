@@ -1,5 +1,6 @@
 #include "screen.hpp"
 #include "../audio/audio_externs.h"
+#include "../audio/ControlRegistry.hpp"
 
 
 namespace gui {
@@ -131,7 +132,8 @@ void Screen::drawWidgets(Widget* firstWidget) {
 //==========================================================
 
 class HomeScreen : public Screen {
-    audio::Control<float> headphoneVolume {"Vol.HP", 0.5f, {0.01, 1}, [](float vol) { output_amp.gain(vol);} };
+    dezip::Value headphoneGain {0.5f, dezip::Ramp::Linear, 20, [](float vol) { output_amp.gain(vol); }};
+    audio::Control<float> headphoneVolume {"Vol.HP", 0.5f, {0.01, 1}, [this](float vol) { headphoneGain.set(vol);} };
     
     audio::Control<float> lineoutVolume {"Vol.Ln", 0.5f, {0.01, 1}, [](float vol) { } };
 
@@ -168,6 +170,20 @@ public:
 
         volumes.setIncrements(audio::small_f, audio::small_f);
         mixVAAdditive.setIncrements(audio::small_f, audio::small_f);
+
+        auto out = audio::control_registry().group("out");
+        out.add("hp_volume", headphoneVolume);
+        out.add("line_volume", lineoutVolume);
+        out.group("mix").add("va", mixVA);
+        out.group("mix").add("additive", mixAdditive);
+
+        auto in = audio::control_registry().group("in");
+        in.add("level", testControl5);
+        in.add("mic_level", testControl6);
+
+        auto test = audio::control_registry().group("test");
+        test.add("hi", testControl1);
+        test.add("katie", testControl2);
     }
 
     void draw() {
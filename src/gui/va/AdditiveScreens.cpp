@@ -1,5 +1,6 @@
 #include "../screen.hpp"
 #include "../../audio/additive/AddSynth.hpp"
+#include "../../audio/Preset.hpp"
 
 namespace gui {
 
@@ -7,15 +8,19 @@ namespace gui {
 static struct AdditiveScreen : public Screen {
 
     DualNumericalWidget<float> mixes;
-    DualWidget<NumericalWidget<int>, NumericalWidget<float>> filterTypeFreq;
+    DualNumericalWidget<int> debugStealing;
+    DualWidget<NumericalWidget<float>, NumericalWidget<int>> scanFrame;
+    DualNumericalWidget<float> envelope;
 
     AdditiveScreen() : 
         Screen(),
         mixes(audio::as_module.spectralMix, audio::as_module.banksMix),
-        filterTypeFreq(NumericalWidget(audio::as_module.debug), NumericalWidget(audio::as_module.frequency))
+        debugStealing(audio::as_module.debug, audio::as_module.stealing),
+        scanFrame(NumericalWidget(audio::as_module.scan), NumericalWidget(audio::as_module.frame)),
+        envelope(audio::as_module.attack, audio::as_module.release)
         
     {
-        mixes.link(filterTypeFreq);
+        mixes.link(debugStealing).link(scanFrame).link(envelope);
         focusedWidget = &mixes;
 
         mixes.setIncrements(audio::small_f, audio::small_f);
@@ -57,8 +62,15 @@ struct PartialEditor : public Screen {
         main_oled.fillScreen(0); // clear the screen
 
         main_oled.setCursor(0, 0);
-        main_oled.print(firstPartialOffset / 128);
 
+        auto *partials = audio::as_module.partials();
+        if (!partials) {
+            main_oled.print("No memory for frames.");
+            dirty = false;
+            return;
+        }
+
+        main_oled.print(firstPartialOffset / 128);
         int partial = 0;
 
         for (int row = 0; row < 4; row++) {
@@ -68,10 +80,8 @@ struct PartialEditor : public Screen {
             main_oled.drawFastHLine(0, yh, 128, colors::darkgrey);
 
             for (int i = 0; i < 32; i++) {
-                auto& part = reinterpret_cast<std::tuple<float, float>&>(audio::as_module.partials()[(partial + firstPartialOffset) * 2]);
-                auto polar = em::to_polar(part);
-                float r = std::get<0>(polar);
-                float phase = std::get<1>(polar);
+                float r = partials->amplitude[partial + firstPartialOffset];
+                float phase = partials->phase[partial + firstPartialOffset];
 
                 if (partial == selectedPartial) 
                     main_oled.drawRect(i * 4, y, 4, 32, colors::cornflowerblue);
@@ -101,12 +111,11 @@ struct PartialEditor : public Screen {
     }
 
     virtual void passInputToWidget(InputEvent const& event) override {
-        auto& part = reinterpret_cast<std::tuple<float, float>&>(audio::as_module.partials()[referenced() * 2]);
-
-        auto polar = em::to_polar(part);
+        auto *partials = audio::as_module.partials();
+        if (!partials) return;
 
-        float r = std::get<0>(polar);
-        float phase = std::get<1>(polar);
+        float r = partials->amplitude[referenced()];
+        float phase = partials->phase[referenced()];
 
         if (event.in == Input::RIGHT_ROTATE) {
             if (event.trans == InputTransition::DECR) {
@@ -135,19 +144,21 @@ struct PartialEditor : public Screen {
             phase = 0;
         }
 
-        part = em::to_cartesean({r, phase});
+        // keep the phase in [-PI, PI] for display.
+        partials->set(referenced(), r, remainderf(phase, 2 * (float) PI));
+        audio::as_module.partialsChanged();
 
         sully();
     }
 
-    virtual bool hasScope() { return true; }
+    virtual bool hasScope() { return additive1.samples() != nullptr; }
 
 
     int offset = 0;
     int direction = 1;
     virtual void drawScope() {
-        display::draw_buffer_in_scope(additive1.samples().data() + offset);
-        if (offset > 0 && offset < (additive1.samples().size() - 128)) {
+        display::draw_buffer_in_scope(additive1.samples() + offset);
+        if (offset > 0 && offset < (AudioSynthAdditive::signal_table_size - 128)) {
             offset += direction;
         }
         else if (offset <= 0) {
@@ -272,6 +283,7 @@ struct BankWaveEditor : public Screen {
                     t -= 440;
                     if (t < 440) { t = 440; }
                 }
+                audio::as_module.bankVoiceChanged();
                 sully();
             }
             return;
@@ -314,6 +326,7 @@ struct BankWaveEditor : public Screen {
             phase = 0;
         }
 
+        audio::as_module.bankVoiceChanged();
         sully();
     }
 
@@ -335,7 +348,7 @@ struct BankWaveEditor : public Screen {
 
     virtual void drawScope() override {
         float tempBuffer[128];
-        oscbank1.previewVoice(tempBuffer, 128);
+        oscbank1.previewVoice(tempBuffer, 128, selectedTimepoint);
         display::draw_buffer_in_scope2(tempBuffer);
      }
     
@@ -371,6 +384,62 @@ struct FFTGrid : public Screen {
 
 } fftGrid;
 
+/// @brief Save and load the whole synth on the SD card. Left knob picks a slot, left push loads
+/// it and right push saves over it. The card is only touched from here, in `loop()`.
+struct PresetScreen : public Screen {
+    static constexpr int slots = 16;
+
+    audio::Control<int> slot {"Slot", 0, {0, slots - 1}};
+    NumericalWidget<int> slotWidget;
+
+    /// @brief How the last load or save went.
+    const char *status = "";
+
+    PresetScreen() : Screen(), slotWidget(slot) {
+        focusedWidget = &slotWidget;
+        flowWidgets({0, 18}, &slotWidget);
+    }
+
+    void path(char *out, size_t size) {
+        snprintf(out, size, "preset%02d.tie", *slot);
+    }
+
+    void draw() override {
+        using namespace display;
+
+        if (!dirty) return;
+        drawHelper("Presets", colors::darkorange, 10, &slotWidget);
+
+        main_oled.setTextSize(1);
+        main_oled.setTextColor(colors::white, colors::black);
+        main_oled.setCursor(2, 18 + slotWidget.height() + 8);
+        main_oled.print("L push: load");
+        main_oled.setCursor(2, 18 + slotWidget.height() + 18);
+        main_oled.print("R push: save");
+        main_oled.setCursor(2, 18 + slotWidget.height() + 34);
+        main_oled.print(status);
+    }
+
+    virtual void passInputToWidget(InputEvent const& event) override {
+        if (event.in == Input::LEFT_ROTATE || event.in == Input::RIGHT_ROTATE) {
+            Screen::passInputToWidget(event);
+            return;
+        }
+
+        if (event.trans != InputTransition::RELEASE) return;
+
+        char file[16];
+        path(file, sizeof(file));
+        if (event.in == Input::LEFT_PUSH) {
+            status = audio::load_preset(file) ? "Loaded." : "Couldn't load.";
+        }
+        else {
+            status = audio::save_preset(file) ? "Saved." : "Couldn't save.";
+        }
+        sully();
+    }
+} presetScreen;
+
 static struct ScreenConstructor {
     ScreenConstructor() {
         // link our screens together
@@ -384,6 +453,7 @@ static struct ScreenConstructor {
 
         partialEditors[0].link(&fftGrid, East); // add in the FFT grid.
         fftGrid.link(&bankWaveEditor, East);
+        bankWaveEditor.link(&presetScreen, East);
 
 
         // link to main graph
@@ -1,4 +1,10 @@
 #include "audio/ScopeTap.h"
+#include "audio/Control.hpp"
+
+// Audio objects update in the order they're constructed, so this has to come before gui_gen.icc:
+// queued control changes land at the top of every block, before anything renders.
+audio::ControlSync controlSync;
+
 #include "audio/gui_gen.icc"
 
 AudioAnalyzeScope scopeTap;
@@ -9,8 +15,10 @@ AudioConnection patchCord_0(output_mixer, 0, scopeTap, 0);
 #include <Metro.h>
 #include "gui/screen.hpp"
 #include "audio/Control.hpp"
+#include "audio/ControlRegistry.hpp"
 #include "audio/va/VASynth.hpp"
 #include "audio/additive/AddSynth.hpp"
+#include "audio/Benchmark.hpp"
 #include "midi_impl.hpp"
 
 // Teensy-provided function to get the chip temperature.
@@ -58,9 +66,16 @@ void setup() {
 
   Serial.println("Finished synth setup.\nInitializing controls.");
 
-  // run all controls to initialize them.
+  auto &registry = audio::control_registry();
+  registry.build();
+  Serial.printf("%d controls registered, %d without a path.\n", registry.size(), registry.unregistered());
+
+  // queue all controls to initialize them; they're applied at the start of the next block.
   audio::run_all_control_updates();
 
+#ifdef TIE_BENCHMARK
+  audio::run_benchmarks();
+#endif
 }
 
 
@@ -95,6 +110,9 @@ void loop() {
   usbMIDI.read();
   bool has_midi_input = serial_midi.read();
 
+  // render edited spectra even when the screen's blanked; notes might be scanning through them.
+  audio::as_module.service();
+
   if (has_midi_input) {
     blankTimeout.reset();
     blankMode = false;
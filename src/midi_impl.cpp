@@ -8,7 +8,7 @@ void recvNoteOn(byte channel, byte note, byte velocity) {
 }
 
 void recvNoteOff(byte channel, byte note, byte velocity) {
-
+    audio::as_module.noteOff(note, velocity / 127.f);
 }
 
 void recvControlChange(byte channel, byte control, byte value) {
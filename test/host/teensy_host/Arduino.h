@@ -0,0 +1,84 @@
+#pragma once
+
+// Just enough of the Teensy core for the Arduino-free parts of the tree to build and run on a
+// host, for the native tests. Nothing here talks to hardware.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+
+#define DMAMEM
+#define EXTMEM
+#define FASTRUN
+#define FLASHMEM
+#define PROGMEM
+
+#define F_CPU_ACTUAL 600000000
+
+/// @brief The cycle counter. The host has no such thing, so it stays at zero.
+extern volatile uint32_t ARM_DWT_CYCCNT;
+
+// Teensy's min and max take mixed argument types, which the vendored audio code relies on.
+template <class A, class B>
+constexpr auto min(A &&a, B &&b) -> decltype(a < b ? std::forward<A>(a) : std::forward<B>(b)) {
+    return a < b ? std::forward<A>(a) : std::forward<B>(b);
+}
+
+template <class A, class B>
+constexpr auto max(A &&a, B &&b) -> decltype(a < b ? std::forward<A>(a) : std::forward<B>(b)) {
+    return a >= b ? std::forward<A>(a) : std::forward<B>(b);
+}
+
+uint32_t micros();
+uint32_t millis();
+inline void delay(uint32_t) {}
+inline void yield() {}
+
+inline long random(long howbig) { return howbig > 0 ? std::rand() % howbig : 0; }
+inline long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+inline void randomSeed(uint32_t seed) { std::srand(seed); }
+
+inline void *extmem_malloc(size_t size) { return std::malloc(size); }
+inline void *extmem_calloc(size_t count, size_t size) { return std::calloc(count, size); }
+inline void extmem_free(void *p) { std::free(p); }
+
+/// @brief Serial, printing to stdout.
+class HostSerial {
+public:
+    void begin(long) {}
+    explicit operator bool() const { return true; }
+
+    template <typename T>
+    void print(T const& v, int digits = 2) {
+        if constexpr (std::is_floating_point_v<T>) std::printf("%.*f", digits, (double) v);
+        else if constexpr (std::is_integral_v<T>) std::printf("%lld", (long long) v);
+        else std::printf("%s", (const char *) v);
+    }
+
+    template <typename T>
+    void println(T const& v, int digits = 2) {
+        print(v, digits);
+        println();
+    }
+
+    void println() { std::printf("\n"); }
+
+    template <typename... Args>
+    void printf(const char *format, Args... args) { std::printf(format, args...); }
+};
+
+extern HostSerial Serial;
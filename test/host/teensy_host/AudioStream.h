@@ -0,0 +1,39 @@
+#pragma once
+
+// The parts of the Teensy AudioStream interface the tree's headers use. Audio objects can be
+// declared and constructed, but nothing schedules them: tests call update() themselves.
+
+#include <Arduino.h>
+
+#ifndef AUDIO_BLOCK_SAMPLES
+#define AUDIO_BLOCK_SAMPLES 128
+#endif
+
+#define AUDIO_SAMPLE_RATE_EXACT 44117.64706f
+#define AUDIO_SAMPLE_RATE AUDIO_SAMPLE_RATE_EXACT
+
+typedef struct audio_block_struct {
+    uint8_t ref_count;
+    uint8_t reserved1;
+    uint16_t memory_pool_index;
+    int16_t data[AUDIO_BLOCK_SAMPLES];
+} audio_block_t;
+
+class AudioStream {
+public:
+    AudioStream(unsigned char ninput, audio_block_t **iqueue) {}
+    virtual ~AudioStream() {}
+    virtual void update(void) = 0;
+
+protected:
+    bool active = false;
+
+    static audio_block_t *allocate(void) { return new audio_block_t {}; }
+    static void release(audio_block_t *block) { delete block; }
+    void transmit(audio_block_t *block, unsigned char index = 0) {}
+    audio_block_t *receiveReadOnly(unsigned int index = 0) { return nullptr; }
+    audio_block_t *receiveWritable(unsigned int index = 0) { return nullptr; }
+};
+
+inline void AudioNoInterrupts() {}
+inline void AudioInterrupts() {}
@@ -0,0 +1,74 @@
+#include <Arduino.h>
+#include <arm_math.h>
+#include <chrono>
+#include <complex>
+#include <vector>
+
+HostSerial Serial;
+volatile uint32_t ARM_DWT_CYCCNT = 0;
+
+namespace {
+
+const auto start = std::chrono::steady_clock::now();
+
+uint64_t elapsed_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// @brief In-place radix-2 FFT, in double precision so it's a fair reference for the float CMSIS one.
+void fft(std::vector<std::complex<double>> &x) {
+    const size_t n = x.size();
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(x[i], x[j]);
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1) {
+        const std::complex<double> w = std::polar(1.0, -2 * M_PI / len);
+        for (size_t i = 0; i < n; i += len) {
+            std::complex<double> wk = 1;
+            for (size_t k = 0; k < len / 2; k++, wk *= w) {
+                const auto a = x[i + k], b = x[i + k + len / 2] * wk;
+                x[i + k] = a + b;
+                x[i + k + len / 2] = a - b;
+            }
+        }
+    }
+}
+
+}
+
+uint32_t micros() { return (uint32_t) elapsed_us(); }
+uint32_t millis() { return (uint32_t) (elapsed_us() / 1000); }
+
+// The CMSIS-DSP functions the analysis uses. The twiddle tables they need live in
+// arm_common_tables.c, which isn't vendored, so the host gets these stand-ins instead.
+extern "C" {
+
+arm_status arm_rfft_fast_init_2048_f32(arm_rfft_fast_instance_f32 *S) {
+    S->fftLenRFFT = 2048;
+    return ARM_MATH_SUCCESS;
+}
+
+void arm_mult_f32(const float32_t *a, const float32_t *b, float32_t *out, uint32_t size) {
+    for (uint32_t i = 0; i < size; i++) out[i] = a[i] * b[i];
+}
+
+/// @brief Forward transform only, packed like CMSIS: DC and Nyquist in the first pair, then
+/// the real and imaginary part of each bin in between.
+void arm_rfft_fast_f32(const arm_rfft_fast_instance_f32 *S, float32_t *in, float32_t *out, uint8_t ifftFlag) {
+    const int n = S->fftLenRFFT;
+    std::vector<std::complex<double>> x(in, in + n);
+    fft(x);
+
+    out[0] = x[0].real();
+    out[1] = x[n / 2].real();
+    for (int k = 1; k < n / 2; k++) {
+        out[2 * k] = x[k].real();
+        out[2 * k + 1] = x[k].imag();
+    }
+}
+
+}
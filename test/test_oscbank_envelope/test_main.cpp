@@ -0,0 +1,100 @@
+#include <unity.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "ext/Audio/synth_additive.h"
+
+namespace {
+
+constexpr int harmonics = AudioSynthOscBank::bankSize;
+constexpr int points = AudioSynthOscBank::nControlPoints;
+constexpr int block = AUDIO_BLOCK_SAMPLES;
+using Envelope = AudioSynthOscBank::Envelope;
+
+/// @brief `span()` may differ from `next()` by float rounding as it accumulates the ramp.
+constexpr double envelope_tolerance = 1.2e-7;
+
+/// @brief And the block kernel adds the Taylor kernel's error on top, across every harmonic.
+constexpr double output_tolerance = 7.2e-7;
+
+/// @brief Render random envelopes two ways, a sample at a time with `next()` and a double
+/// precision sine, and a piece at a time with `span()` and `render_block()`, and compare them.
+/// Envelopes include one-sample, zero-length and long segments, and a release at a random block.
+void test_span_matches_next() {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    double envelopeError = 0, outputError = 0;
+    for (int trial = 0; trial < 300; trial++) {
+        Envelope prototype;
+        for (int p = 0; p < points; p++) {
+            const int kind = rng() % 5;
+            prototype[p].t = kind == 0 ? 1 : kind == 1 ? (int) (rng() % 40) : (int) (rng() % 3000) + 1;
+            if (trial % 7 == 0 && p == 3) prototype[p].t = 0;
+
+            for (int h = 0; h < harmonics; h++) {
+                prototype[p].a[h] = unit(rng) / (h + 1);
+                prototype[p].a[h + harmonics] = unit(rng) * 4294967000.f;
+            }
+        }
+
+        Envelope stepped = prototype, spanned = prototype;
+        stepped.restart();
+        spanned.restart();
+
+        uint32_t phases[harmonics] = {}, increments[harmonics];
+        for (int h = 0; h < harmonics; h++) increments[h] = (h + 1) * (uint32_t) (unit(rng) * 1e7);
+
+        const int releaseAt = rng() % 400, release = 1 + rng() % 5000;
+        float start[2 * harmonics], step[2 * harmonics];
+
+        for (int b = 0; b < 600; b++) {
+            if (b == releaseAt) {
+                stepped.zero(release);
+                spanned.zero(release);
+            }
+
+            float expected[block] = {}, actual[block] = {};
+            for (int i = 0; i < block; i++) {
+                const float *a = stepped.next();
+                for (int h = 0; h < harmonics; h++) {
+                    const uint32_t phase = phases[h] + increments[h] * (i + 1) + (uint32_t) a[h + harmonics];
+                    expected[i] += a[h] * std::sin(phase * (2 * M_PI / 4294967296.0));
+                }
+            }
+
+            for (int n = 0; n < block;) {
+                const int length = spanned.span(block - n, start, step);
+                const oscbank::Ramp ramp {start, step, start + harmonics, step + harmonics};
+                oscbank::render_block<oscbank::Taylor>(phases, increments, ramp, harmonics, n, length, actual);
+                n += length;
+            }
+
+            for (int h = 0; h < harmonics; h++) {
+                envelopeError = std::max(envelopeError, (double) std::fabs(stepped.a[h] - spanned.a[h]));
+            }
+            for (int i = 0; i < block; i++) {
+                outputError = std::max(outputError, (double) std::fabs(expected[i] - actual[i]));
+            }
+            for (int h = 0; h < harmonics; h++) phases[h] += increments[h] * block;
+
+            TEST_ASSERT_EQUAL(stepped.finished(), spanned.finished());
+        }
+    }
+
+    std::printf("max envelope error %g, max output error %g\n", envelopeError, outputError);
+    TEST_ASSERT_LESS_OR_EQUAL_DOUBLE(envelope_tolerance, envelopeError);
+    TEST_ASSERT_LESS_OR_EQUAL_DOUBLE(output_tolerance, outputError);
+}
+
+}
+
+void setUp() {}
+void tearDown() {}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_span_matches_next);
+    return UNITY_END();
+}
@@ -0,0 +1,368 @@
+#include <unity.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "audio/Preset.hpp"
+
+using namespace audio;
+
+namespace {
+
+constexpr int bins = 64;
+using Partials = additive::PolarPartials<bins>;
+using Envelope = SequenceInterpolator<4, 3>;
+
+/// @brief What the controls' update functions last saw, and how often they ran.
+float appliedLevel = 0;
+int levelUpdates = 0;
+
+Control<float> level("Level", 0.5f, [](float v) { appliedLevel = v; levelUpdates++; });
+Control<int> transpose("Transpose", 0);
+Control<uint8_t> mode("Mode", 1);
+
+/// @brief Registered under a registry of the test's own, so nothing else is in the preset.
+ControlRegistry registry;
+
+void register_controls() {
+    static bool registered = false;
+    if (registered) return;
+    registered = true;
+
+    auto group = registry.group("test");
+    group.add("level", level);
+    group.add("transpose", transpose);
+    group.add("mode", mode);
+}
+
+/// @brief Everything a preset holds, so tests can write one and check what came back.
+struct State {
+    Partials sparse {}, dense {};
+    Envelope envelope;
+
+    void fill(float seed) {
+        sparse.clear();
+        sparse.set(1, seed, 0.25f);
+        sparse.set(17, seed / 2, -1.5f);
+        sparse.set(bins - 1, seed / 4, 3.f);
+
+        for (int i = 0; i < bins; i++) dense.set(i, seed / (i + 1), seed * i);
+
+        for (int p = 0; p < Envelope::n_points; p++) {
+            envelope[p].t = 100 * (p + 1) + (int) seed;
+            for (int v = 0; v < Envelope::n_values; v++) envelope[p].a[v] = seed * (p + 1) + v;
+        }
+    }
+};
+
+std::vector<uint8_t> write(State const& state) {
+    std::vector<uint8_t> bytes(4096);
+    MemoryPreset memory(bytes.data(), bytes.size());
+
+    PresetWriter writer(memory);
+    writer.controls(registry);
+    writer.frame(0, state.sparse);
+    writer.frame(1, state.dense);
+    writer.envelope(state.envelope);
+    TEST_ASSERT_TRUE(writer.finish());
+
+    bytes.resize(memory.size());
+    return bytes;
+}
+
+/// @brief What a read found, section by section.
+struct Loaded {
+    bool valid = false;
+    int controls = -1;
+    int frames = 0;
+    bool envelope = false;
+};
+
+/// @brief Read a preset into `state` the way `read_preset()` does: stage the controls, then apply
+/// them in a batch once everything's been read.
+Loaded read(std::vector<uint8_t> bytes, State &state) {
+    MemoryPreset memory(bytes.data(), bytes.size(), bytes.size());
+    PresetReader reader(memory);
+
+    Loaded loaded;
+    StagedControls staged;
+    Partials scratch;
+    PresetReader::Section section;
+    while (reader.next(section)) {
+        switch (section.kind) {
+        case preset::Section::Controls:
+            loaded.controls = reader.controls(registry, staged);
+            break;
+
+        case preset::Section::Frame:
+            if (reader.frame([&](int i) { return i == 0 ? &state.sparse : i == 1 ? &state.dense : nullptr; }, scratch) >= 0) {
+                loaded.frames++;
+            }
+            break;
+
+        case preset::Section::Envelope:
+            loaded.envelope = reader.envelope(state.envelope);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    {
+        ControlBatch batch;
+        staged.apply();
+    }
+    apply_queued_controls();
+
+    loaded.valid = reader.valid();
+    return loaded;
+}
+
+void assert_equal(State const& expected, State const& actual) {
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected.sparse.amplitude.data(), actual.sparse.amplitude.data(), bins);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected.sparse.phase.data(), actual.sparse.phase.data(), bins);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected.dense.amplitude.data(), actual.dense.amplitude.data(), bins);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected.dense.phase.data(), actual.dense.phase.data(), bins);
+
+    for (int p = 0; p < Envelope::n_points; p++) {
+        TEST_ASSERT_EQUAL(expected.envelope[p].t, actual.envelope[p].t);
+        TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected.envelope[p].a, actual.envelope[p].a, Envelope::n_values);
+    }
+}
+
+/// @brief Where each section ends, from the section headers.
+std::vector<size_t> section_ends(std::vector<uint8_t> const& bytes) {
+    std::vector<size_t> ends;
+    for (size_t at = 8; at + 8 <= bytes.size(); ) {
+        uint32_t payload;
+        std::memcpy(&payload, &bytes[at + 4], sizeof(payload));
+        at += 8 + payload;
+        ends.push_back(at);
+    }
+    return ends;
+}
+
+/// @brief Controls, sparse and dense frames, and the envelope all come back as they were written.
+void test_round_trip() {
+    State saved;
+    saved.fill(0.75f);
+    level.set(0.125f);
+    transpose.set(-7);
+    mode.set(3);
+    apply_queued_controls();
+
+    const auto bytes = write(saved);
+
+    State loaded;
+    loaded.fill(9.f);
+    level.set(1.f);
+    transpose.set(12);
+    mode.set(0);
+    apply_queued_controls();
+
+    const Loaded result = read(bytes, loaded);
+    TEST_ASSERT_TRUE(result.valid);
+    TEST_ASSERT_EQUAL(3, result.controls);
+    TEST_ASSERT_EQUAL(2, result.frames);
+    TEST_ASSERT_TRUE(result.envelope);
+
+    TEST_ASSERT_EQUAL_FLOAT(0.125f, level.get());
+    TEST_ASSERT_EQUAL_FLOAT(0.125f, appliedLevel);
+    TEST_ASSERT_EQUAL(-7, transpose.get());
+    TEST_ASSERT_EQUAL(3, mode.get());
+    assert_equal(saved, loaded);
+}
+
+/// @brief A section of a kind the reader doesn't know is passed over, and what follows still loads.
+void test_unknown_section_skipped() {
+    State saved;
+    saved.fill(2.f);
+    level.set(0.25f);
+    apply_queued_controls();
+    const auto written = write(saved);
+
+    // a section from some later version, straight after the header.
+    const uint8_t unknown[] = {0x7F, 0, 0, 0, 5, 0, 0, 0, 1, 2, 3, 4, 5};
+    std::vector<uint8_t> bytes(written.begin(), written.begin() + 8);
+    bytes.insert(bytes.end(), unknown, unknown + sizeof(unknown));
+    bytes.insert(bytes.end(), written.begin() + 8, written.end());
+
+    State loaded;
+    level.set(1.f);
+    apply_queued_controls();
+
+    const Loaded result = read(bytes, loaded);
+    TEST_ASSERT_TRUE(result.valid);
+    TEST_ASSERT_EQUAL(3, result.controls);
+    TEST_ASSERT_EQUAL(2, result.frames);
+    TEST_ASSERT_TRUE(result.envelope);
+    TEST_ASSERT_EQUAL_FLOAT(0.25f, level.get());
+    assert_equal(saved, loaded);
+}
+
+/// @brief Cut anywhere inside a section, a preset reads as damaged, and the sections before the
+/// cut still load. Cut between sections, it's indistinguishable from a shorter preset.
+void test_truncated() {
+    State saved;
+    saved.fill(1.f);
+    const auto bytes = write(saved);
+    const auto ends = section_ends(bytes);
+    TEST_ASSERT_EQUAL(4, ends.size());
+    TEST_ASSERT_EQUAL(bytes.size(), ends.back());
+
+    for (size_t cut = 0; cut < bytes.size(); cut++) {
+        State loaded;
+        const Loaded result = read(std::vector<uint8_t>(bytes.begin(), bytes.begin() + cut), loaded);
+
+        int complete = 0;
+        bool atBoundary = cut == 8;
+        for (size_t end : ends) {
+            if (end <= cut) complete++;
+            if (end == cut) atBoundary = true;
+        }
+
+        char message[48];
+        snprintf(message, sizeof(message), "cut at %d of %d", (int) cut, (int) bytes.size());
+        TEST_ASSERT_EQUAL_MESSAGE(atBoundary, result.valid, message);
+        if (complete >= 1) TEST_ASSERT_EQUAL_MESSAGE(3, result.controls, message);
+        TEST_ASSERT_EQUAL_MESSAGE(std::max(0, std::min(complete - 1, 2)), result.frames, message);
+        TEST_ASSERT_EQUAL_MESSAGE(complete == 4, result.envelope, message);
+    }
+}
+
+/// @brief A frame or envelope that's cut short leaves what it would have replaced exactly as it was,
+/// while the sections before it still load.
+void test_cut_section_leaves_table() {
+    State saved;
+    saved.fill(1.f);
+    const auto bytes = write(saved);
+    const auto ends = section_ends(bytes);
+
+    State before;
+    before.fill(5.f);
+
+    // partway into the dense frame: the sparse one loads, the dense one and the envelope don't.
+    State loaded = before;
+    Loaded result = read(std::vector<uint8_t>(bytes.begin(), bytes.begin() + ends[1] + 100), loaded);
+    TEST_ASSERT_FALSE(result.valid);
+    TEST_ASSERT_EQUAL(1, result.frames);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(saved.sparse.amplitude.data(), loaded.sparse.amplitude.data(), bins);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(before.dense.amplitude.data(), loaded.dense.amplitude.data(), bins);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(before.dense.phase.data(), loaded.dense.phase.data(), bins);
+
+    // partway into the envelope: both frames load, the envelope doesn't.
+    loaded = before;
+    result = read(std::vector<uint8_t>(bytes.begin(), bytes.begin() + ends[2] + 30), loaded);
+    TEST_ASSERT_FALSE(result.valid);
+    TEST_ASSERT_EQUAL(2, result.frames);
+    TEST_ASSERT_FALSE(result.envelope);
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(saved.dense.amplitude.data(), loaded.dense.amplitude.data(), bins);
+    for (int p = 0; p < Envelope::n_points; p++) {
+        TEST_ASSERT_EQUAL(before.envelope[p].t, loaded.envelope[p].t);
+        TEST_ASSERT_EQUAL_FLOAT_ARRAY(before.envelope[p].a, loaded.envelope[p].a, Envelope::n_values);
+    }
+}
+
+/// @brief Anything that doesn't start with the magic number, or is from a newer version, isn't read at all.
+void test_bad_header() {
+    State saved;
+    saved.fill(1.f);
+    const auto bytes = write(saved);
+
+    auto badMagic = bytes;
+    badMagic[0] = 'X';
+    State loaded;
+    Loaded result = read(badMagic, loaded);
+    TEST_ASSERT_FALSE(result.valid);
+    TEST_ASSERT_EQUAL(-1, result.controls);
+    TEST_ASSERT_EQUAL(0, result.frames);
+
+    auto newer = bytes;
+    newer[4] = preset::version + 1;
+    result = read(newer, loaded);
+    TEST_ASSERT_FALSE(result.valid);
+    TEST_ASSERT_EQUAL(-1, result.controls);
+}
+
+/// @brief Values that don't fit a control's type saturate instead of wrapping.
+void test_load_saturates() {
+    auto load_float = [](_ControlBase &control, float f) {
+        ControlValue v {ControlValue::Float, 0};
+        std::memcpy(&v.bits, &f, sizeof(f));
+        control.load(v);
+    };
+
+    load_float(mode, 300.f);
+    TEST_ASSERT_EQUAL(255, mode.get());
+    load_float(mode, -3.f);
+    TEST_ASSERT_EQUAL(0, mode.get());
+    load_float(transpose, 1e20f);
+    TEST_ASSERT_EQUAL(INT32_MAX, transpose.get());
+    load_float(transpose, -1e20f);
+    TEST_ASSERT_EQUAL(INT32_MIN, transpose.get());
+
+    mode.load({ControlValue::Signed, (uint32_t) -5});
+    TEST_ASSERT_EQUAL(0, mode.get());
+    mode.load({ControlValue::Unsigned, 1000});
+    TEST_ASSERT_EQUAL(255, mode.get());
+    transpose.load({ControlValue::Unsigned, 0xFFFFFFFFu});
+    TEST_ASSERT_EQUAL(INT32_MAX, transpose.get());
+    transpose.load({ControlValue::Signed, (uint32_t) -5});
+    TEST_ASSERT_EQUAL(-5, transpose.get());
+
+    level.load({ControlValue::Signed, (uint32_t) -5});
+    TEST_ASSERT_EQUAL_FLOAT(-5.f, level.get());
+    apply_queued_controls();
+}
+
+/// @brief Staged controls take their new values straight away, but the audio interrupt doesn't
+/// apply any of them until the batch is gone.
+void test_batch_holds_controls() {
+    level.set(0.5f);
+    apply_queued_controls();
+    TEST_ASSERT_EQUAL_FLOAT(0.5f, appliedLevel);
+
+    ControlValue value {ControlValue::Float, 0};
+    const float staged_level = 0.875f;
+    std::memcpy(&value.bits, &staged_level, sizeof(staged_level));
+
+    StagedControls staged;
+    staged.entries[staged.count++] = {&level, value};
+    const int updates = levelUpdates;
+    {
+        ControlBatch batch;
+        staged.apply();
+        TEST_ASSERT_EQUAL_FLOAT(0.875f, level.get());
+
+        apply_queued_controls(); // as the audio interrupt would, mid-batch
+        TEST_ASSERT_EQUAL(updates, levelUpdates);
+        TEST_ASSERT_EQUAL_FLOAT(0.5f, appliedLevel);
+    }
+
+    apply_queued_controls();
+    TEST_ASSERT_EQUAL(updates + 1, levelUpdates);
+    TEST_ASSERT_EQUAL_FLOAT(0.875f, appliedLevel);
+}
+
+}
+
+void setUp() {
+    register_controls();
+    apply_queued_controls();
+}
+
+void tearDown() {}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_unknown_section_skipped);
+    RUN_TEST(test_truncated);
+    RUN_TEST(test_cut_section_leaves_table);
+    RUN_TEST(test_bad_header);
+    RUN_TEST(test_load_saturates);
+    RUN_TEST(test_batch_holds_controls);
+    return UNITY_END();
+}
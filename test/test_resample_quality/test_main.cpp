@@ -0,0 +1,138 @@
+#include <unity.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include "ext/Audio/Resampler.h"
+#include "ext/Audio/resample-quality.h"
+#include "ext/Audio/synth_additive.h"
+
+// The resampling report `bench_resampling()` prints on the device, for the methods that build on
+// the host. The windowed sinc lives in synth_additive.cpp with the rest of the audio objects, so
+// it's only on the device. Times are the host's, in nanoseconds per sample.
+//
+// Every line goes to stdout, and to the file named by RESAMPLE_REPORT if it's set:
+//
+//     RESAMPLE_REPORT=resampling.jsonl pio test -e native -f test_resample_quality
+
+namespace {
+
+constexpr double ratios[] = {0.5, 0.75, 0.99, 1.0, 1.01, 1.5, 2.0, 3.0};
+
+float table[1 << resample::quality_table_bits];
+float out[resample::quality_outputs];
+
+FILE *report = nullptr;
+
+/// @brief Measure a method at every ratio and report it.
+/// @return the worst passband ripple and aliasing over the ratios, in dB
+template <typename Render>
+resample::ResampleQuality report_resampling(const char *method, Render &&render) {
+    resample::ResampleQuality worst {0, NAN, -INFINITY};
+    for (double ratio : ratios) {
+        // measured first, so anything a method sets up for a ratio isn't in the time.
+        const auto quality = resample::resample_quality(render, ratio, table, out);
+
+        const auto start = std::chrono::steady_clock::now();
+        render(table, resample::quality_table_bits, ratio, out, resample::quality_outputs);
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        worst.passbandRippleDb = std::max(worst.passbandRippleDb, quality.passbandRippleDb);
+        worst.aliasingDb = std::max(worst.aliasingDb, quality.aliasingDb);
+
+        char line[192];
+        resample::format_resample_report(line, sizeof(line), method, ratio, ns / resample::quality_outputs, quality, "ns_per_sample");
+        std::printf("%s\n", line);
+        if (report) std::fprintf(report, "%s\n", line);
+    }
+    return worst;
+}
+
+/// @brief Stream a looped table through the S/PDIF `Resampler`, a block at a time, as the bench does.
+void render_streamed(bool fixed, const float *table, int sizeBits, double ratio, float *out, int count) {
+    constexpr int n = 128;
+    static float block[n];
+
+    // a fresh one for each ratio, so its filter table is only built, and timed, once.
+    static std::optional<Resampler> streamer;
+    static double streamerRatio = 0;
+    if (ratio != streamerRatio) {
+        streamer.reset();
+        streamer.emplace();
+        streamerRatio = ratio;
+    }
+    TEST_ASSERT_TRUE(streamer->configure(ratio * AUDIO_SAMPLE_RATE_EXACT, AUDIO_SAMPLE_RATE_EXACT));
+    const int mask = (1 << sizeBits) - 1;
+
+    int read = 0, written = 0;
+    while (written < count) {
+        for (int i = 0; i < n; i++) block[i] = table[(read + i) & mask];
+
+        float *inputs[1] = {block};
+        float *outputs[1] = {out + written};
+        uint16_t processed, produced;
+        if (fixed) streamer->resampleFixed<1>(inputs, n, processed, outputs, count - written, produced);
+        else streamer->resample<1>(inputs, n, processed, outputs, count - written, produced);
+
+        read += processed;
+        written += produced;
+    }
+}
+
+void test_polyphase() {
+    static AudioSynthAdditive::Resampler polyphase;
+    const auto worst = report_resampling("polyphase", [](const float *table, int sizeBits, double ratio, float *out, int count) {
+        const uint32_t increment = ratio * (1u << (32 - sizeBits));
+        uint32_t phase = 0;
+        for (int i = 0; i < count; i++, phase += increment) {
+            out[i] = polyphase.read_cycle(table, sizeBits, phase);
+        }
+    });
+
+    // no anti-aliasing, and 8 taps droop near the top of the passband: these only catch regressions.
+    TEST_ASSERT_LESS_THAN_DOUBLE(1.5, worst.passbandRippleDb);
+    TEST_ASSERT_LESS_THAN_DOUBLE(-15, worst.aliasingDb);
+}
+
+void test_resampler() {
+    for (bool fixed : {false, true}) {
+        const auto worst = report_resampling(fixed ? "resampler_fixed" : "resampler", [fixed](const float *table, int sizeBits, double ratio, float *out, int count) {
+            render_streamed(fixed, table, sizeBits, ratio, out, count);
+        });
+
+        // the filter is designed for 100 dB, and its length caps what the higher ratios reach.
+        TEST_ASSERT_LESS_THAN_DOUBLE(0.01, worst.passbandRippleDb);
+        TEST_ASSERT_LESS_THAN_DOUBLE(-80, worst.aliasingDb);
+    }
+}
+
+void test_wavetable_linear() {
+    static int16_t samples[1 << resample::quality_table_bits];
+    const auto worst = report_resampling("wavetable_linear", [](const float *table, int sizeBits, double ratio, float *out, int count) {
+        resample::WavetableLinear::quantize(table, samples, 1 << sizeBits);
+        resample::WavetableLinear::render(samples, sizeBits, ratio, out, count);
+    });
+
+    // linear interpolation is as rough as it gets, which is why the wavetable is in the report.
+    TEST_ASSERT_LESS_THAN_DOUBLE(5, worst.passbandRippleDb);
+    TEST_ASSERT_LESS_THAN_DOUBLE(-7, worst.aliasingDb);
+}
+
+}
+
+void setUp() {}
+void tearDown() {}
+
+int main() {
+    if (const char *path = std::getenv("RESAMPLE_REPORT")) report = std::fopen(path, "w");
+
+    UNITY_BEGIN();
+    RUN_TEST(test_polyphase);
+    RUN_TEST(test_resampler);
+    RUN_TEST(test_wavetable_linear);
+    const int failures = UNITY_END();
+
+    if (report) std::fclose(report);
+    return failures;
+}
@@ -0,0 +1,90 @@
+#include <unity.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "audio/additive/Stft.hpp"
+
+using namespace audio;
+
+namespace {
+
+constexpr float sample_rate = 44117.647f;
+constexpr int hop = 512;
+constexpr int hops = 12;
+constexpr int harmonics = 8;
+
+constexpr double f0_start = 220.5;
+constexpr double glide = 0.01;
+
+/// @brief A harmonic tone with 1/k amplitudes, gliding up by `glide` over the signal, plus a little noise.
+std::vector<float> gliding_tone() {
+    std::vector<float> signal(StftAnalyzer::frame_size + hop * hops);
+    double phase[harmonics + 1] = {};
+    std::srand(1);
+
+    for (size_t n = 0; n < signal.size(); n++) {
+        const double f0 = f0_start * (1 + glide * n / signal.size());
+        double v = 0;
+        for (int k = 1; k <= harmonics; k++) {
+            phase[k] += 2 * M_PI * f0 * k / sample_rate;
+            v += 0.5 / k * std::sin(phase[k]);
+        }
+        signal[n] = v + 1e-4 * (std::rand() / (float) RAND_MAX - 0.5f);
+    }
+    return signal;
+}
+
+/// @brief Peaks land within 0.35 Hz and 4% of each harmonic, and each harmonic keeps one track throughout.
+void test_gliding_harmonics() {
+    const auto signal = gliding_tone();
+    static StftAnalyzer analyzer(sample_rate);
+    static PartialTracker tracker;
+    SpectralPeak peaks[StftAnalyzer::max_peaks];
+
+    double maxFrequencyError = 0, maxAmplitudeError = 0;
+    int found = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int h = 0; h < hops; h++) {
+        const int count = analyzer.analyze(&signal[h * hop], peaks);
+        tracker.update(peaks, count);
+
+        // the frequency at the middle of the frame
+        const double f0 = f0_start * (1 + glide * (h * hop + StftAnalyzer::frame_size / 2.0) / signal.size());
+        for (int i = 0; i < count; i++) {
+            const int k = std::lround(peaks[i].frequency / f0);
+            if (k < 1 || k > harmonics) continue;
+
+            const double amplitude = 0.5 / k;
+            maxFrequencyError = std::fmax(maxFrequencyError, std::fabs(peaks[i].frequency - k * f0));
+            maxAmplitudeError = std::fmax(maxAmplitudeError, std::fabs(peaks[i].amplitude - amplitude) / amplitude);
+            found++;
+        }
+    }
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("max frequency error %.3f Hz, max amplitude error %.2f%%, %.1f us/frame (host, reference FFT)\n",
+        maxFrequencyError, maxAmplitudeError * 100, us / hops);
+
+    TEST_ASSERT_EQUAL(harmonics * hops, found);
+    TEST_ASSERT_LESS_THAN_DOUBLE(0.35, maxFrequencyError);
+    TEST_ASSERT_LESS_THAN_DOUBLE(0.04, maxAmplitudeError);
+
+    TEST_ASSERT_EQUAL(harmonics, tracker.size());
+    for (int t = 0; t < tracker.size(); t++) {
+        TEST_ASSERT_EQUAL(hops - 1, tracker[t].age);
+    }
+}
+
+}
+
+void setUp() {}
+void tearDown() {}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_gliding_harmonics);
+    return UNITY_END();
+}